@@ -2,9 +2,12 @@
 
 #include <zarks/internal/Sampleable2D.h>
 #include <zarks/image/color.h>
+#include <zarks/image/PaletteIndex.h>
 #include <zarks/math/Rect.h>
 #include <zarks/math/Map.h>
+#include <zarks/math/MapT.h>
 #include <zarks/math/VecT.h>
+#include <zarks/internal/progress.h>
 
 #include <string>
 #include <vector>
@@ -19,6 +22,8 @@ namespace zmath
 		Image(zmath::VecInt bounds_in, RGBA col = RGBA::Black());
 		Image(const Map& m);
 		Image(const Map& m, Scheme scheme);
+		Image(const Mapf& m);
+		Image(const Mapf& m, Scheme scheme);
 		Image(std::string path);
 		Image(const Image& img);
 		Image(Image&& img);
@@ -35,20 +40,30 @@ namespace zmath
 
 		std::unique_ptr<Image> Copy(zmath::VecInt min, zmath::VecInt max) const;
 		Image& Paste(const Image& img, VecInt at);
-		Image& Tile(const Image& tile, VecInt tileSize, VecInt offset = VecInt(0, 0));
+		Image& Tile(const Image& tile, VecInt tileSize, VecInt offset = VecInt(0, 0), Filter filter = Filter::Nearest);
 
 		// Manipulators
 		
-		Image& Resize(VecInt to_bounds);
-		Image& Resize(double scaleFactor);
+		// Resamples to new bounds with separable weight tables; see Filter.h
+		Image& Resize(VecInt to_bounds, Filter filter = Filter::Nearest);
+		Image& Resize(double scaleFactor, Filter filter = Filter::Nearest);
 		Image& Clear(RGBA col = RGBA::Black());
 		Image& Negative();
 		Image& RestrictPalette(const std::vector<RGBA>& palette);
+		Image& RestrictPalette(const PaletteIndex& index);
 		Image& Fractalify(int octaves);
 		Image& Droppify(std::array<Vec, 3> origins, std::array<double, 3> periods);
 		Image& BlurGaussian(double sigma, bool blurAlpha = true);
-		Image& PixelateGaussian(const Map& map, double sigma);
+		Image& PixelateGaussian(const Map& map, double sigma, const ProgressFn& progressFn = ProgressFn());
 		Image& EnhanceContrast(double sigma);
+		// As BlurGaussian and EnhanceContrast, but over the (2 * radius + 1)-wide
+		// box around each pixel, via a SummedArea, at a cost independent of radius
+		Image& BoxBlur(int radius, bool blurAlpha = true);
+		Image& EnhanceContrastBox(int radius);
+
+		// The index of each pixel's nearest palette entry, for palettes of up
+		// to 256 colors
+		MapT<uint8> PaletteIndices(const PaletteIndex& index) const;
 
 		// Save an image using STBI
 		void Save(std::string path, unsigned int channels = 3) const;
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <zarks/image/color.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace zmath
+{
+	// Finds the palette entry nearest a color, by RGBA::Distance (alpha is
+	// ignored), with ties going to the lowest index. The answer is always the
+	// one a linear scan over the palette would give; only the search differs.
+	//
+	// Entries live in a k-d tree over RGB. Optionally, the RGB cube is also
+	// split into cells of 'cubeBits' bits per channel (5 or 6), each holding
+	// only the entries that can be nearest to some color in it. Building the
+	// cells costs a pass over the palette per cell, so about cells x palette
+	// size work and 2 x 3 x 2^cubeBits x palette size ints of scratch. It
+	// only pays off for small palettes (around a thousand entries or fewer)
+	// with many lookups per entry; larger palettes are faster with the tree.
+	class PaletteIndex
+	{
+	public:
+		PaletteIndex(const std::vector<RGBA>& palette, int cubeBits = 0);
+
+		const std::vector<RGBA>& Palette() const;
+		int CubeBits() const;
+
+		// Index into Palette() of the entry nearest 'col'
+		int Nearest(RGBA col) const;
+
+	private:
+		typedef struct Node {
+			int begin, end; // entries order[begin, end)
+			int axis;       // channel split on, or -1 for a leaf
+			int split;      // order[mid]'s value on 'axis'; left holds <=, right >=
+			int left, right;
+		} Node;
+
+		std::vector<RGBA> palette;
+		std::vector<int> order; // palette indices, arranged by the tree
+		std::vector<Node> nodes;
+
+		int cubeBits;
+		std::vector<uint32_t> cellStart; // cell i's entries are cellEntries[cellStart[i], cellStart[i + 1])
+		std::vector<uint16_t> cellEntries;
+
+		int build(int begin, int end);
+		void search(int node, const int rgb[3], int& best, int& bestDist) const;
+		void buildCube();
+	};
+}
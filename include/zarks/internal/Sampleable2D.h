@@ -2,6 +2,7 @@
 
 #include <zarks/math/VecT.h>
 #include <zarks/internal/zmath_internals.h>
+#include <zarks/internal/parallel.h>
 
 #include <exception>
 
@@ -12,7 +13,11 @@ namespace zmath
 	{
 	protected:
 		VecInt bounds;
-		T** data;
+		// Elements are stored in one contiguous, aligned block. Element (x, y)
+		// lives at data[x * stride + y], so each x-line is contiguous in y and
+		// lines start 'stride' elements apart. stride >= bounds.Y.
+		T* data;
+		int stride;
 		
 		Sampleable2D();
 		Sampleable2D(int x, int y, const T& val = T());
@@ -21,6 +26,7 @@ namespace zmath
 		void BoundCheck(Vec check) const;
 		void BoundCheck(VecInt check) const;
 
+		void AllocData(VecInt newBounds, const T& val = T());
 		virtual void FreeData();
 
 		class Iterator
@@ -88,13 +94,15 @@ namespace zmath
 	template<typename T>
 	inline Sampleable2D<T>::Sampleable2D()
 		: data(nullptr)
+		, stride(0)
 	{}
 
 	template<typename T>
 	inline Sampleable2D<T>::Sampleable2D(VecInt bounds, const T& val)
-		: bounds(VecInt::Max(bounds, VecInt(0, 0)))
+		: data(nullptr)
+		, stride(0)
 	{
-		data = alloc2d<T>(this->bounds.X, this->bounds.Y, val);
+		AllocData(bounds, val);
 	}
 
 	template<typename T>
@@ -105,7 +113,7 @@ namespace zmath
 	template<typename T>
 	inline Sampleable2D<T>::~Sampleable2D()
 	{
-		free2d(data, bounds.X);
+		freeAligned(data, (size_t)bounds.X * stride);
 	}
 
 	template<typename T>
@@ -125,7 +133,7 @@ namespace zmath
 	{
 		BoundCheck(VecInt(x, y));
 
-		data[x][y] = val;
+		(*this)[x][y] = val;
 	}
 
 	template<typename T>
@@ -151,7 +159,7 @@ namespace zmath
 	{
 		BoundCheck(VecInt(x, y));
 
-		return data[x][y];
+		return (*this)[x][y];
 	}
 
 	template<typename T>
@@ -159,7 +167,7 @@ namespace zmath
 	{
 		BoundCheck(VecInt(x, y));
 
-		return data[x][y];
+		return (*this)[x][y];
 	}
 
 	template<typename T>
@@ -177,13 +185,13 @@ namespace zmath
 	template<typename T>
 	inline const T* Sampleable2D<T>::operator[](int x) const
 	{
-		return data[x];
+		return data + (size_t)x * stride;
 	}
 
 	template<typename T>
 	inline T* Sampleable2D<T>::operator[](int x)
 	{
-		return data[x];
+		return data + (size_t)x * stride;
 	}
 
 	template<typename T>
@@ -205,8 +213,9 @@ namespace zmath
 		const VecInt max = pos.Ceil();
 		const Vec within = pos - min;
 
-		T y0 = interp5(data[min.X][min.Y], data[max.X, min.Y], within.X);
-		T y1 = interp5(data[min.X][max.Y], data[max.X, max.Y], within.X);
+		const Sampleable2D& self = *this;
+		T y0 = interp5(self[min.X][min.Y], self[max.X][min.Y], within.X);
+		T y1 = interp5(self[min.X][max.Y], self[max.X][max.Y], within.X);
 		T z = interp5(y0, y1, within.Y);
 
 		return T(z);
@@ -242,11 +251,22 @@ namespace zmath
 		}
 	}
 
+	template<typename T>
+	inline void Sampleable2D<T>::AllocData(VecInt newBounds, const T& val)
+	{
+		FreeData();
+
+		bounds = VecInt::Max(newBounds, VecInt(0, 0));
+		stride = alignedStride<T>(bounds.Y);
+		data = allocAligned<T>((size_t)bounds.X * stride, val);
+	}
+
 	template<typename T>
 	inline void Sampleable2D<T>::FreeData()
 	{
-		free2d<T>(data, bounds.X);
+		freeAligned<T>(data, (size_t)bounds.X * stride);
 		bounds = VecInt(0, 0);
+		stride = 0;
 	}
 
 	//          //
@@ -255,8 +275,8 @@ namespace zmath
 
 	template<typename T>
 	inline Sampleable2D<T>::Iterator::Iterator(Sampleable2D* source, VecInt pos)
-		: source(source)
-		, pos(pos)
+		: pos(pos)
+		, source(source)
 	{}
 
 	template<typename T>
@@ -295,8 +315,8 @@ namespace zmath
 
 	template<typename T>
 	inline Sampleable2D<T>::ConstIterator::ConstIterator(const Sampleable2D* source, VecInt pos)
-		: source(source)
-		, pos(pos)
+		: pos(pos)
+		, source(source)
 	{}
 
 	template<typename T>
@@ -2,6 +2,10 @@
 
 #include <zarks/math/VecT.h>
 
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <unordered_map>
 
 namespace std
@@ -26,6 +30,85 @@ struct hash<zmath::VecT<T>>
 namespace zmath
 {
 
+// 64-bit finalizer from MurmurHash3; every input bit affects every output bit
+inline uint64_t mix64(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Hash of a lattice point in one octave of a seeded noise field. This is a
+// counter-based generator in the SplitMix64 mould: the point and octave are
+// spread into a 64-bit counter by odd Weyl constants, offset by the mixed
+// seed as key, and finalized with mix64. No state is carried between calls,
+// so points can be hashed independently, in any order and on any thread.
+inline uint64_t hashLattice(int x, int y, int octave, uint64_t seedKey)
+{
+    return mix64(seedKey
+        + (uint64_t)(uint32_t)x * 0x9e3779b97f4a7c15ULL
+        + (uint64_t)(uint32_t)y * 0xc2b2ae3d27d4eb4fULL
+        + (uint64_t)(uint32_t)octave * 0x165667b19e3779f9ULL);
+}
+
+// Approximate log2 of a positive, finite x, good to about 1e-8. The
+// exponent is read from the bits; the mantissa, folded into [sqrt(1/2),
+// sqrt(2)), goes through a short atanh series.
+inline double fastLog2(double x)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    int exponent = (int)((bits >> 52) & 0x7ff) - 1023;
+    bits = (bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+    double m;
+    std::memcpy(&m, &bits, sizeof(m));
+
+    if (m > 1.4142135623730951)
+    {
+        m *= 0.5;
+        exponent++;
+    }
+
+    const double s = (m - 1.0) / (m + 1.0);
+    const double s2 = s * s;
+    const double series = s * (2.0 + s2 * (2.0 / 3.0 + s2 * (2.0 / 5.0 + s2 * (2.0 / 7.0))));
+    return exponent + series * 1.4426950408889634;
+}
+
+// Approximate 2^y, good to about 1e-7 relative. The fraction is centred on
+// 0 so a degree 6 Taylor series of e^z suffices.
+inline double fastExp2(double y)
+{
+    // NaN fails every comparison below and must not reach the int cast
+    if (!(y == y)) return y;
+    if (y >= 1024) return std::numeric_limits<double>::infinity();
+    if (y < -1022) return 0;
+
+    const double n = std::floor(y);
+    const double z = (y - n - 0.5) * 0.6931471805599453;
+    const double e = 1 + z * (1 + z * (1.0 / 2 + z * (1.0 / 6 + z * (1.0 / 24 + z * (1.0 / 120 + z * (1.0 / 720))))));
+
+    // 2^n for the normal range, built directly from the exponent bits
+    const uint64_t bits = (uint64_t)((int)n + 1023) << 52;
+    double scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return e * 1.4142135623730951 * scale;
+}
+
+// Approximate std::pow(x, y) for x >= 0, for when y changes too often to
+// specialize on it
+inline double fastPow(double x, double y)
+{
+    if (x == 0) return y > 0 ? 0 : y < 0 ? std::numeric_limits<double>::infinity() : 1;
+    if (std::isinf(x)) return y > 0 ? x : y < 0 ? 0 : 1;
+    // Subnormals, and NaN, which fastLog2 would read as a finite number
+    if (!(x >= std::numeric_limits<double>::min())) return std::pow(x, y);
+    return fastExp2(y * fastLog2(x));
+}
+
 namespace simplex
 {
 
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <zarks/noise/NoiseHash.h>
+#include <zarks/internal/noise_internals.h>
+#include <zarks/internal/zmath_internals.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace zmath
+{
+
+// Scalar kernels behind SimplexPoint and PerlinPoint. They live in a header
+// so that NoiserT can inline them; the batched SIMD versions in Noiser.cpp
+// perform the same operations in the same order.
+namespace points
+{
+
+// Squared radius of a simplex corner's influence
+constexpr double SIMPLEX_R2 = 0.625;
+
+// Quintic fade curve; the SIMD versions evaluate it in the same order
+inline double fade(double t)
+{
+    return fade5(t);
+}
+
+inline double lerp(double a, double b, double t)
+{
+    return t * b + (1.0 - t) * a;
+}
+
+// Contribution of one simplex corner to the point (x, y)
+inline double simplexCorner(double x, double y, double cx, double cy, const NoiseHash& hash)
+{
+    const double t = (cx + cy) * simplex::G2D;
+    const double dx = x - (cx - t);
+    const double dy = y - (cy - t);
+    const Vec g = hash[VecInt((int)cx, (int)cy)];
+
+    const double f = std::max(0.0, SIMPLEX_R2 - (dx * dx + dy * dy));
+    const double f2 = f * f;
+    return f2 * f2 * (dx * g.X + dy * g.Y);
+}
+
+inline double simplexPoint(double x, double y, const NoiseHash& hash)
+{
+    const double s = (x + y) * simplex::F2D;
+    const double bx = std::floor(x + s);
+    const double by = std::floor(y + s);
+    const bool lower = (x + s) - bx > (y + s) - by;
+
+    double Z = 0;
+    Z += simplexCorner(x, y, bx, by, hash);
+    Z += simplexCorner(x, y, bx + (lower ? 1.0 : 0.0), by + (lower ? 0.0 : 1.0), hash);
+    Z += simplexCorner(x, y, bx + 1.0, by + 1.0, hash);
+    return Z;
+}
+
+inline double perlinPoint(double x, double y, const NoiseHash& hash)
+{
+    const double bx = std::floor(x);
+    const double by = std::floor(y);
+    const double ix = x - bx;
+    const double iy = y - by;
+
+    const VecInt base((int)bx, (int)by);
+    const Vec g00 = hash[base];
+    const Vec g01 = hash[base + VecInt(0, 1)];
+    const Vec g10 = hash[base + VecInt(1, 0)];
+    const Vec g11 = hash[base + VecInt(1, 1)];
+
+    const double d00 = ix * g00.X + iy * g00.Y;
+    const double d01 = ix * g01.X + (iy - 1.0) * g01.Y;
+    const double d10 = (ix - 1.0) * g10.X + iy * g10.Y;
+    const double d11 = (ix - 1.0) * g11.X + (iy - 1.0) * g11.Y;
+
+    const double u = fade(ix);
+    return lerp(lerp(d00, d10, u), lerp(d01, d11, u), fade(iy));
+}
+
+} // namespace points
+
+} // namespace zmath
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <zarks/math/VecT.h>
+
+#include <functional>
+#include <vector>
+
+namespace zmath
+{
+	// Execution policy for the library's per-pixel work. Under Exec::Parallel,
+	// Map and Image operations split their x-lines into bands that run on an
+	// internal thread pool. Results are bit-identical to Exec::Serial: bands
+	// never share output, and reductions combine per-line partial results in
+	// line order no matter which thread produced them.
+	enum class Exec {
+		Serial,
+		Parallel,
+	};
+
+	// Library-wide policy. Defaults to Exec::Parallel.
+	void SetExec(Exec policy);
+	Exec GetExec();
+
+	// Overrides the library-wide policy for the calling thread while in scope
+	class ExecScope
+	{
+	public:
+		ExecScope(Exec policy);
+		~ExecScope();
+
+		ExecScope(const ExecScope&) = delete;
+		ExecScope& operator=(const ExecScope&) = delete;
+
+	private:
+		int previous;
+	};
+
+	// Threads used by Exec::Parallel, counting the calling thread. Zero picks
+	// std::thread::hardware_concurrency(). Changing this rebuilds the pool.
+	void SetThreadCount(unsigned threads);
+	unsigned GetThreadCount();
+
+	// Splits [begin, end) into contiguous bands and calls band(bandBegin, bandEnd)
+	// for each, in parallel when the effective policy allows it. Work that is
+	// too small to be worth the hand-off, given 'workPerIndex', runs inline.
+	// Nested calls from inside a band always run inline.
+	void ParallelFor(int begin, int end, const std::function<void(int, int)>& band, int workPerIndex = 1);
+
+	// Calls line(x) for every x-line of a grid with the given bounds
+	template <typename F>
+	void ForEachLine(VecInt bounds, F&& line)
+	{
+		ParallelFor(0, bounds.X, [&](int begin, int end) {
+			for (int x = begin; x < end; x++) line(x);
+		}, bounds.Y);
+	}
+
+	// Reduces each x-line to a T with line(x), then folds the per-line results
+	// in order of x. The fold order is fixed, so the result does not depend on
+	// the execution policy or thread count.
+	template <typename T, typename LineFn, typename FoldFn>
+	T ReduceLines(VecInt bounds, T init, LineFn&& line, FoldFn&& fold)
+	{
+		std::vector<T> partials(bounds.X > 0 ? bounds.X : 0, init);
+		ForEachLine(bounds, [&](int x) { partials[x] = line(x); });
+
+		T result = init;
+		for (const T& partial : partials)
+		{
+			result = fold(result, partial);
+		}
+		return result;
+	}
+}
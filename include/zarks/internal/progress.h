@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+
+namespace zmath
+{
+	// Receives progress from a long-running operation: 'stage' names the
+	// operation and 'fraction' runs from 0 to 1. Return false to cancel it.
+	// Calls never overlap, but may come from any of the library's threads.
+	// An empty ProgressFn, the default everywhere, reports nothing.
+	typedef std::function<bool(const char* stage, double fraction)> ProgressFn;
+
+	// Thrown by an operation that was cancelled through its ProgressFn
+	class Cancelled : public std::runtime_error
+	{
+	public:
+		Cancelled(const char* stage);
+	};
+
+	// Counts the units (lines, tiles, triangles) of one operation for a
+	// ProgressFn. The callback runs when the operation starts and then about
+	// every hundredth of the way through. Once it returns false, Stopped()
+	// tells the remaining units to skip their work and Finish() throws.
+	// With no callback, Step() and Stopped() cost a branch each.
+	class Progress
+	{
+	public:
+		Progress(const ProgressFn& fn, const char* stage, size_t units);
+
+		Progress(const Progress&) = delete;
+		Progress& operator=(const Progress&) = delete;
+
+		// Marks one unit as done; safe to call from several threads
+		void Step();
+		bool Stopped() const;
+		// Throws Cancelled if the operation was cancelled
+		void Finish() const;
+
+	private:
+		const ProgressFn& fn;
+		const char* stage;
+		size_t units;
+		size_t every;
+
+		std::atomic<size_t> done;
+		std::atomic<bool> stopped;
+		std::mutex reportMutex;
+
+		void report();
+	};
+}
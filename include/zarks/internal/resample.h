@@ -0,0 +1,31 @@
+#pragma once
+
+#include <zarks/math/Filter.h>
+#include <zarks/math/VecT.h>
+
+#include <vector>
+
+namespace zmath
+{
+namespace resample
+{
+	// Precomputed weights for resampling one axis from 'srcLen' samples to
+	// 'dstLen'. Output i is the sum over k < count[i] of
+	// weights[i * taps + k] * src[first[i] + k]. Taps past the edges are
+	// folded onto the edge samples, and each output's weights sum to 1.
+	typedef struct Weights {
+		int taps;
+		std::vector<int> first;
+		std::vector<int> count;
+		std::vector<double> weights;
+	} Weights;
+
+	Weights MakeWeights(Filter filter, int srcLen, int dstLen);
+
+	// Resamples a grid laid out as Sampleable2D lays it out: element (x, y)
+	// is the 'channels' doubles at src[x * srcStride + y * channels]. Runs
+	// as a pass along x and then one along y, each split over threads.
+	void Resample(Filter filter, const double* src, VecInt srcBounds, int srcStride,
+	              double* dst, VecInt dstBounds, int dstStride, int channels);
+}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+
+namespace zmath
+{
+	// Elementwise kernels over contiguous runs of doubles. Each kernel has a
+	// scalar, SSE2 and AVX2 implementation; the widest one supported by the
+	// running CPU is picked once, the first time any kernel is used. All
+	// paths produce bit-identical results.
+	namespace simd
+	{
+		enum class Level {
+			Scalar,
+			SSE2,
+			AVX2,
+		};
+
+		// The best level supported by this CPU
+		Level DetectLevel();
+		// The level kernels are currently dispatched to
+		Level ActiveLevel();
+		// Force a level, e.g. to compare against the scalar path. Requests
+		// above what the CPU supports are lowered to DetectLevel().
+		void SetLevel(Level level);
+
+		void Fill(double* dst, size_t n, double val);
+		void Replace(double* dst, size_t n, double val, double with);
+
+		void Add(double* dst, const double* src, size_t n);
+		void Sub(double* dst, const double* src, size_t n);
+		void Mul(double* dst, const double* src, size_t n);
+		// Division by zero saturates to +/-DOUBLEMAX, matching Map::operator/=
+		void Div(double* dst, const double* src, size_t n);
+
+		void Add(double* dst, size_t n, double val);
+		void Sub(double* dst, size_t n, double val);
+		void Mul(double* dst, size_t n, double val);
+		void Div(double* dst, size_t n, double val);
+
+		// dst[i] += src[i] * scale
+		void AddScaled(double* dst, const double* src, size_t n, double scale);
+
+		void Abs(double* dst, size_t n);
+		void Min(double* dst, size_t n, double max);
+		void Max(double* dst, size_t n, double min);
+		void Clamp(double* dst, size_t n, double min, double max);
+		void Pow(double* dst, size_t n, double exp);
+
+		// Reductions. Every path accumulates element i into lane i % 4 and
+		// folds the four lanes in the same order, so these are bit-identical
+		// across levels too. MinMaxSum requires n > 0.
+		void MinMaxSum(const double* src, size_t n, double& min, double& max, double& sum);
+		double SumSquaredDiff(const double* src, size_t n, double mean);
+	}
+}
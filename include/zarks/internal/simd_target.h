@@ -0,0 +1,31 @@
+#pragma once
+
+// Platform plumbing shared by the translation units that carry SIMD kernels.
+// Only include this from .cpp files: it pulls in the intrinsics headers.
+
+#include <zarks/internal/simd.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+	#define ZMATH_SIMD_X86
+	#include <immintrin.h>
+
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#include <intrin.h>
+		#define ZMATH_TARGET_AVX2
+	#else
+		#define ZMATH_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+// Calls the implementation matching simd::ActiveLevel()
+#ifdef ZMATH_SIMD_X86
+	#define ZMATH_DISPATCH(avx2Fn, sse2Fn, scalarFn, ...) \
+		switch (::zmath::simd::ActiveLevel()) \
+		{ \
+		case ::zmath::simd::Level::AVX2: avx2Fn(__VA_ARGS__); break; \
+		case ::zmath::simd::Level::SSE2: sse2Fn(__VA_ARGS__); break; \
+		default: scalarFn(__VA_ARGS__); break; \
+		}
+#else
+	#define ZMATH_DISPATCH(avx2Fn, sse2Fn, scalarFn, ...) scalarFn(__VA_ARGS__);
+#endif
@@ -3,6 +3,9 @@
 #include <limits>
 #include <array>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <new>
 
 #include <zarks/image/color.h>
 
@@ -50,32 +53,55 @@ namespace zmath
 	// MEMORY //
 	//        //
 
+	// Alignment, in bytes, of every grid buffer allocated by the library. One
+	// cache line, which is also wide enough for any SIMD register we use.
+	constexpr size_t GRID_ALIGNMENT = 64;
+
+	// Number of elements between the starts of two consecutive grid lines of
+	// the given length, padded so that every line begins on an aligned address
+	// whenever the element size allows it.
 	template <typename T>
-	T** alloc2d(int width, int height, const T& fill = T())
+	int alignedStride(int length)
 	{
-		T** data = new T * [width];
-		for (int x = 0; x < width; x++)
+		constexpr int perLine = (GRID_ALIGNMENT % sizeof(T) == 0) ? GRID_ALIGNMENT / sizeof(T) : 1;
+		return ((length + perLine - 1) / perLine) * perLine;
+	}
+
+	// Allocate 'count' elements of T, each initialized to 'fill', in a single
+	// block aligned to GRID_ALIGNMENT. Must be released with freeAligned().
+	template <typename T>
+	T* allocAligned(size_t count, const T& fill = T())
+	{
+		if (count == 0) return nullptr;
+
+		// Over-allocate so the block can be shifted onto an alignment boundary.
+		// The shift is stored in the byte just before the aligned block.
+		unsigned char* raw = new unsigned char[count * sizeof(T) + GRID_ALIGNMENT];
+		const size_t shift = GRID_ALIGNMENT - reinterpret_cast<uintptr_t>(raw) % GRID_ALIGNMENT;
+		unsigned char* aligned = raw + shift;
+		aligned[-1] = (unsigned char)shift;
+
+		T* data = reinterpret_cast<T*>(aligned);
+		for (size_t i = 0; i < count; i++)
 		{
-			data[x] = new T[height];
-			for (int y = 0; y < height; y++)
-			{
-				data[x][y] = fill;
-			}
+			new (data + i) T(fill);
 		}
 
 		return data;
 	}
 
 	template <typename T>
-	void free2d(T**& data, int width)
+	void freeAligned(T*& data, size_t count)
 	{
 		if (data)
 		{
-			for (int x = 0; x < width; x++)
+			for (size_t i = 0; i < count; i++)
 			{
-				delete[] data[x];
+				data[i].~T();
 			}
-			delete[] data;
+
+			unsigned char* aligned = reinterpret_cast<unsigned char*>(data);
+			delete[] (aligned - aligned[-1]);
 
 			data = nullptr;
 		}
@@ -126,15 +152,20 @@ namespace zmath
 		return t * val1 + (1.0 - t) * val0;
 	}
 
+	// Quintic fade curve, 6t^5 - 15t^4 + 10t^3, in Horner form
+	constexpr double fade5(double t)
+	{
+		return t * t * t * (t * (t * 6.0 - 15.0) + 10.0);
+	}
+
 	inline double interp5(double val0, double val1, double t)
 	{
-		double t_adj = 6 * std::pow(t, 5) - 15 * std::pow(t, 4) + 10 * std::pow(t, 3);
-		return interpLinear(val0, val1, t_adj);
+		return interpLinear(val0, val1, fade5(t));
 	}
 
 	inline RGBA interp5(RGBA val0, RGBA val1, double t)
 	{
-		double t_adj = 6 * std::pow(t, 5) - 15 * std::pow(t, 4) + 10 * std::pow(t, 3);
+		const double t_adj = fade5(t);
 		return RGBA(
 			std::round(interpLinear(val0.R, val1.R, t_adj)),
 			std::round(interpLinear(val0.G, val1.G, t_adj)),
@@ -2,6 +2,7 @@
 
 #include <zarks/math/3D/Triangle3D.h>
 #include <zarks/math/Map.h>
+#include <zarks/internal/progress.h>
 
 #include <vector>
 #include <array>
@@ -37,9 +38,10 @@ namespace zmath
 		Tessellation3D& Scale(double by, Vec3 around = Vec3());
 		Tessellation3D& Scale(double scaleX, double scaleY, double scaleZ, Vec3 around = Vec3());
 
-		// Write data to STL file
-		void WriteSTL(std::ofstream& f, bool normals, int beginning = 0, int end = 0) const;
-		void WriteSTL(std::string filepath, bool normals, int beginning = 0, int end = 0) const;
+		// Write data to STL file. Throws Cancelled, leaving the file incomplete,
+		// if 'progressFn' returns false.
+		void WriteSTL(std::ofstream& f, bool normals, int beginning = 0, int end = 0, const ProgressFn& progressFn = ProgressFn()) const;
+		void WriteSTL(std::string filepath, bool normals, int beginning = 0, int end = 0, const ProgressFn& progressFn = ProgressFn()) const;
 
 		//         //
 		// PRESETS //
@@ -62,7 +64,7 @@ namespace zmath
 
 		static void WriteVertex(std::ofstream& f, const Vec3& v);
 
-		static Tessellation3D LoadSTL(std::ifstream& f);
+		static Tessellation3D LoadSTL(std::ifstream& f, const ProgressFn& progressFn = ProgressFn());
 
 	private:
 		std::vector<Triangle3D> data;
@@ -0,0 +1,15 @@
+#pragma once
+
+namespace zmath
+{
+	// Resampling filters for Map::Resize and Image::Resize. Except for
+	// Nearest, each widens to cover the source pixels when shrinking, so
+	// downsampling averages rather than aliases.
+	enum class Filter {
+		Nearest,  // the source pixel each output pixel falls in
+		Area,     // the source area each output pixel covers; best for shrinking
+		Bilinear,
+		Bicubic,  // Keys cubic, a = -0.5
+		Lanczos3,
+	};
+}
@@ -1,13 +1,29 @@
 #pragma once
 #include <zarks/math/VecT.h>
+#include <zarks/math/Filter.h>
 #include <zarks/math/GaussField.h>
 #include <zarks/internal/Sampleable2D.h>
 
+#include <atomic>
 #include <string>
 #include <memory>
+#include <mutex>
 
 namespace zmath
 {
+	template <typename E>
+	class MapExpr;
+
+	// Summary statistics of a map, as returned by Map::Stats()
+	typedef struct MapStats {
+		double min;
+		double max;
+		double sum;
+		double mean;
+		double variance; // sample variance, as in Map::Variance()
+		double stdDev;
+	} MapStats;
+
 	class Map : public Sampleable2D<double>
 	{
 	private:
@@ -22,11 +38,41 @@ namespace zmath
 
 		Map& operator= (const Map& m);
 		Map& operator= (Map&& m);
+		// Evaluates a lazy expression in a single sweep; see MapExpr.h
+		template <typename E>
+		Map& operator= (const MapExpr<E>& expr);
 
 		void FreeData() override;
 
+		// Element access. The non-const overloads mark cached statistics as
+		// stale, so they are shadowed here; the const ones are inherited.
+		// operator[] hands out a raw line pointer whose later writes can't be
+		// seen, so like GetIterator() it turns caching off for good.
+
+		using Sampleable2D::operator[];
+		using Sampleable2D::At;
+		using Sampleable2D::Set;
+		using Sampleable2D::GetIterator;
+
+		double* operator[](int x);
+		double& At(int x, int y);
+		double& At(VecInt pos);
+		void Set(int x, int y, const double& val);
+		void Set(int x, int y, double&& val);
+		void Set(VecInt pos, const double& val);
+		void Set(VecInt pos, double&& val);
+		Iterator GetIterator(VecInt pos);
+
 		// Map characteristics
 
+		// Min, max, sum, mean, variance and standard deviation from a single
+		// reduction. The result is cached until the map is next modified, and
+		// the getters below all share it. Caching is limited to maps whose
+		// data is only reached through Set() and the library's own operations:
+		// once a submap, iterator, non-const line pointer from operator[] or
+		// non-const reference from At() has been handed out, writes through it
+		// can't be seen, so the map stops caching.
+		MapStats Stats() const;
 		double GetMin() const;
 		double GetMax() const;
 		std::pair<double, double> GetMinMax() const;
@@ -46,6 +92,9 @@ namespace zmath
 
 		// Chainable manipulation functions
 
+		// Resamples to new bounds with separable weight tables; see Filter.h
+		Map& Resize(VecInt to_bounds, Filter filter = Filter::Nearest);
+		Map& Resize(double scaleFactor, Filter filter = Filter::Nearest);
 		Map& Clear(double val);
 		Map& Interpolate(double newMin, double newMax);
 		Map& Abs();
@@ -55,6 +104,15 @@ namespace zmath
 		Map& Apply(const GaussField& gauss);
 		Map& Apply(double(*calculation)(double));
 
+		// Local operators over the (2 * radius + 1)-wide window around each
+		// value, clipped at the edges, via a SummedArea. Their cost doesn't
+		// depend on the radius.
+
+		// Replaces each value with its window's mean
+		Map& BoxBlur(int radius);
+		// Replaces each value v with (v - mean) / (std + epsilon) over its window
+		Map& LocalContrast(int radius, double epsilon = 1e-9);
+
 		Map SlopeMap();
 		Map& BoundMax(double newMax);
 		Map& BoundMin(double newMin);
@@ -88,5 +146,98 @@ namespace zmath
 
 	private:
 		bool subMap; // only true for maps created with operator() calls
+
+		mutable MapStats stats;
+		mutable std::atomic<bool> statsValid{ false };
+		mutable std::atomic<bool> shared{ false }; // set once a submap, iterator, line pointer or reference exists
+		mutable std::mutex statsMutex;
+
+		void invalidate() const;
+		void markShared() const;
+		double* line(int x);
+
+		friend double* writeLine(Map& map, int x);
 	};
+
+	// Library-internal write access to a line of a map. Unlike operator[],
+	// it leaves the stats cache on, so it is only for code that is done with
+	// the pointer before handing the map back.
+	inline double* writeLine(Map& map, int x)
+	{
+		return map.line(x);
+	}
+
+	//     //
+	// Map //
+	//     //
+
+	inline void Map::invalidate() const
+	{
+		// Relaxed: only ever cleared here, and parallel writers may all clear it at once
+		if (statsValid.load(std::memory_order_relaxed))
+		{
+			statsValid.store(false, std::memory_order_relaxed);
+		}
+	}
+
+	inline void Map::markShared() const
+	{
+		if (!shared.load(std::memory_order_relaxed))
+		{
+			shared.store(true, std::memory_order_relaxed);
+		}
+	}
+
+	inline double* Map::operator[](int x)
+	{
+		markShared();
+		invalidate();
+		return Sampleable2D::operator[](x);
+	}
+
+	inline double* Map::line(int x)
+	{
+		invalidate();
+		return Sampleable2D::operator[](x);
+	}
+
+	inline double& Map::At(int x, int y)
+	{
+		markShared();
+		invalidate();
+		return Sampleable2D::At(x, y);
+	}
+
+	inline double& Map::At(VecInt pos)
+	{
+		return At(pos.X, pos.Y);
+	}
+
+	inline void Map::Set(int x, int y, const double& val)
+	{
+		invalidate();
+		Sampleable2D::Set(x, y, val);
+	}
+
+	inline void Map::Set(int x, int y, double&& val)
+	{
+		Set(x, y, (const double&)val);
+	}
+
+	inline void Map::Set(VecInt pos, const double& val)
+	{
+		Set(pos.X, pos.Y, val);
+	}
+
+	inline void Map::Set(VecInt pos, double&& val)
+	{
+		Set(pos.X, pos.Y, (const double&)val);
+	}
+
+	inline Map::Iterator Map::GetIterator(VecInt pos)
+	{
+		invalidate();
+		shared = true;
+		return Sampleable2D::GetIterator(pos);
+	}
 }
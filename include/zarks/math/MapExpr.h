@@ -0,0 +1,448 @@
+#pragma once
+
+#include <zarks/math/Map.h>
+#include <zarks/math/MapT.h>
+#include <zarks/internal/zmath_internals.h>
+#include <zarks/internal/parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Opt-in lazy evaluation for chains of elementwise Map/MapT operations.
+//
+// Lazy(map) wraps a map in an expression. Abs, Pow, the Bound* clamps and
+// arithmetic with scalars or other maps then only build up a description
+// of the work, and the whole chain is evaluated in a single sweep when the
+// expression is assigned to a map:
+//
+//     map = Lazy(map).Abs().BoundMin(0.25).Mul(other).Pow(0.55);
+//
+// Interpolate needs the min and max of everything before it, so it is a
+// fusion barrier: the expression so far is evaluated (tracking min/max in
+// the same sweep) and the chain continues lazily on top of that result.
+//
+// Expressions built from Lazy(const Map&) only reference their map, which
+// must outlive them. Lazy(Map&&) takes ownership instead, so it is safe to
+// write e.g. 'auto e = Lazy(Simplex(cfg)).Abs();'.
+
+namespace zmath
+{
+	namespace expr
+	{
+		//           //
+		// OPERATORS //
+		//           //
+
+		namespace ops
+		{
+			template <typename T>
+			struct Abs {
+				T operator()(const T& v) const { return AbsT(v); }
+			};
+
+			template <typename T>
+			struct Pow {
+				T exp;
+				T operator()(const T& v) const { return std::pow(v, exp); }
+			};
+
+			template <typename T>
+			struct BoundMax {
+				T max;
+				T operator()(const T& v) const { return std::min(max, v); }
+			};
+
+			template <typename T>
+			struct BoundMin {
+				T min;
+				T operator()(const T& v) const { return std::max(min, v); }
+			};
+
+			template <typename T>
+			struct Bound {
+				T min, max;
+				T operator()(const T& v) const { return std::min(max, std::max(min, v)); }
+			};
+
+			template <typename T>
+			struct AddScalar {
+				T val;
+				T operator()(const T& v) const { return v + val; }
+			};
+
+			template <typename T>
+			struct SubScalar {
+				T val;
+				T operator()(const T& v) const { return v - val; }
+			};
+
+			template <typename T>
+			struct MulScalar {
+				T val;
+				T operator()(const T& v) const { return v * val; }
+			};
+
+			// Division by zero leaves values untouched, like Map::operator/=(double)
+			template <typename T>
+			struct DivScalar {
+				T val;
+				T operator()(const T& v) const { return (val == 0) ? v : v / val; }
+			};
+
+			// Same arithmetic as Map::Interpolate, given the old min and range
+			template <typename T>
+			struct Rescale {
+				T oldMin, oldRange, newMin, newRange;
+				T operator()(const T& v) const { return (v - oldMin) / oldRange * newRange + newMin; }
+			};
+
+			template <typename T>
+			struct Add {
+				T operator()(const T& a, const T& b) const { return a + b; }
+			};
+
+			template <typename T>
+			struct Sub {
+				T operator()(const T& a, const T& b) const { return a - b; }
+			};
+
+			template <typename T>
+			struct Mul {
+				T operator()(const T& a, const T& b) const { return a * b; }
+			};
+
+			// Division by zero saturates, like Map::operator/=(const Map&)
+			template <typename T>
+			struct Div {
+				T operator()(const T& a, const T& b) const
+				{
+					if (b == 0)
+					{
+						if (a > 0) return std::numeric_limits<T>::max();
+						if (a < 0) return std::numeric_limits<T>::lowest();
+						return a;
+					}
+					return a / b;
+				}
+			};
+		} // namespace ops
+
+		//       //
+		// NODES //
+		//       //
+
+		// Every node exposes Bounds() and Line(x). Line(x) returns a light
+		// object whose operator[](y) evaluates the node at (x, y), so the
+		// innermost loop only ever touches raw line pointers.
+
+		template <typename T>
+		struct TerminalLine {
+			const T* data;
+			T operator[](int y) const { return data[y]; }
+		};
+
+		template <typename M>
+		class Terminal
+		{
+		public:
+			typedef M Container;
+			typedef typename std::decay<decltype(std::declval<const M&>()[0][0])>::type Value;
+
+			explicit Terminal(const M& m)
+				: map(&m)
+			{}
+
+			explicit Terminal(M&& m)
+				: owned(std::make_shared<const M>(std::move(m)))
+				, map(owned.get())
+			{}
+
+			VecInt Bounds() const { return map->Bounds(); }
+			TerminalLine<Value> Line(int x) const { return { (*map)[x] }; }
+
+		private:
+			std::shared_ptr<const M> owned;
+			const M* map;
+		};
+
+		template <typename L, typename Op>
+		struct UnaryLine {
+			L line;
+			Op op;
+			auto operator[](int y) const { return op(line[y]); }
+		};
+
+		template <typename E, typename Op>
+		class Unary
+		{
+		public:
+			typedef typename E::Container Container;
+			typedef typename E::Value Value;
+
+			Unary(const E& e, Op op)
+				: e(e)
+				, op(op)
+			{}
+
+			VecInt Bounds() const { return e.Bounds(); }
+			auto Line(int x) const { return UnaryLine<decltype(e.Line(x)), Op>{ e.Line(x), op }; }
+
+		private:
+			E e;
+			Op op;
+		};
+
+		template <typename L, typename R, typename Op>
+		struct BinaryLine {
+			L lhs;
+			R rhs;
+			Op op;
+			auto operator[](int y) const { return op(lhs[y], rhs[y]); }
+		};
+
+		template <typename L, typename R, typename Op>
+		class Binary
+		{
+		public:
+			typedef typename L::Container Container;
+			typedef typename L::Value Value;
+
+			Binary(const L& lhs, const R& rhs, Op op)
+				: lhs(lhs)
+				, rhs(rhs)
+				, op(op)
+			{
+				if (lhs.Bounds() != rhs.Bounds())
+				{
+					throw std::runtime_error("Map bounds don't match!");
+				}
+			}
+
+			VecInt Bounds() const { return lhs.Bounds(); }
+			auto Line(int x) const
+			{
+				return BinaryLine<decltype(lhs.Line(x)), decltype(rhs.Line(x)), Op>{ lhs.Line(x), rhs.Line(x), op };
+			}
+
+		private:
+			L lhs;
+			R rhs;
+			Op op;
+		};
+	} // namespace expr
+
+	//         //
+	// MAPEXPR //
+	//         //
+
+	template <typename E>
+	class MapExpr
+	{
+	public:
+		typedef typename E::Container Container;
+		typedef typename E::Value Value;
+
+		template <typename Op>
+		using UnaryExpr = MapExpr<expr::Unary<E, Op>>;
+		template <typename R, template <typename> class Op>
+		using BinaryExpr = MapExpr<expr::Binary<E, R, Op<Value>>>;
+
+		explicit MapExpr(const E& e)
+			: e(e)
+		{}
+
+		VecInt Bounds() const { return e.Bounds(); }
+		auto Line(int x) const { return e.Line(x); }
+		const E& Node() const { return e; }
+
+		// Evaluate into an existing map of the same bounds, in one sweep
+		template <typename M>
+		void EvalTo(M& out) const
+		{
+			const VecInt bounds = Bounds();
+			if (out.Bounds() != bounds)
+			{
+				throw std::runtime_error("Map bounds don't match!");
+			}
+
+			ForEachLine(bounds, [&](int x) {
+				const auto line = e.Line(x);
+				Value* outLine = writeLine(out, x);
+				for (int y = 0; y < bounds.Y; y++)
+				{
+					outLine[y] = line[y];
+				}
+			});
+		}
+
+		// Evaluate into a newly allocated map
+		Container Eval() const
+		{
+			Container out(Bounds());
+			EvalTo(out);
+			return out;
+		}
+
+		operator Container() const { return Eval(); }
+
+		// Chainable manipulation functions
+
+		UnaryExpr<expr::ops::Abs<Value>> Abs() const { return unary(expr::ops::Abs<Value>{}); }
+		UnaryExpr<expr::ops::Pow<Value>> Pow(Value exp) const { return unary(expr::ops::Pow<Value>{ exp }); }
+		UnaryExpr<expr::ops::BoundMax<Value>> BoundMax(Value newMax) const { return unary(expr::ops::BoundMax<Value>{ newMax }); }
+		UnaryExpr<expr::ops::BoundMin<Value>> BoundMin(Value newMin) const { return unary(expr::ops::BoundMin<Value>{ newMin }); }
+		UnaryExpr<expr::ops::Bound<Value>> Bound(Value newMin, Value newMax) const { return unary(expr::ops::Bound<Value>{ newMin, newMax }); }
+
+		UnaryExpr<expr::ops::AddScalar<Value>> Add(Value val) const { return unary(expr::ops::AddScalar<Value>{ val }); }
+		UnaryExpr<expr::ops::SubScalar<Value>> Sub(Value val) const { return unary(expr::ops::SubScalar<Value>{ val }); }
+		UnaryExpr<expr::ops::MulScalar<Value>> Mul(Value val) const { return unary(expr::ops::MulScalar<Value>{ val }); }
+		UnaryExpr<expr::ops::DivScalar<Value>> Div(Value val) const { return unary(expr::ops::DivScalar<Value>{ val }); }
+
+		template <typename R> BinaryExpr<R, expr::ops::Add> Add(const MapExpr<R>& rhs) const { return binary<expr::ops::Add>(rhs.Node()); }
+		template <typename R> BinaryExpr<R, expr::ops::Sub> Sub(const MapExpr<R>& rhs) const { return binary<expr::ops::Sub>(rhs.Node()); }
+		template <typename R> BinaryExpr<R, expr::ops::Mul> Mul(const MapExpr<R>& rhs) const { return binary<expr::ops::Mul>(rhs.Node()); }
+		template <typename R> BinaryExpr<R, expr::ops::Div> Div(const MapExpr<R>& rhs) const { return binary<expr::ops::Div>(rhs.Node()); }
+
+		BinaryExpr<expr::Terminal<Container>, expr::ops::Add> Add(const Container& m) const { return binary<expr::ops::Add>(expr::Terminal<Container>(m)); }
+		BinaryExpr<expr::Terminal<Container>, expr::ops::Sub> Sub(const Container& m) const { return binary<expr::ops::Sub>(expr::Terminal<Container>(m)); }
+		BinaryExpr<expr::Terminal<Container>, expr::ops::Mul> Mul(const Container& m) const { return binary<expr::ops::Mul>(expr::Terminal<Container>(m)); }
+		BinaryExpr<expr::Terminal<Container>, expr::ops::Div> Div(const Container& m) const { return binary<expr::ops::Div>(expr::Terminal<Container>(m)); }
+
+		// Fusion barrier. Evaluates everything so far while tracking its min
+		// and max, then continues lazily with the rescale on top.
+		MapExpr<expr::Unary<expr::Terminal<Container>, expr::ops::Rescale<Value>>> Interpolate(Value newMin, Value newMax) const
+		{
+			const VecInt bounds = Bounds();
+			Container out(bounds);
+			if (bounds.Area() == 0)
+			{
+				throw std::runtime_error("Can't interpolate an empty map!");
+			}
+
+			const Value first = e.Line(0)[0];
+			const std::pair<Value, Value> minmax = ReduceLines(bounds, std::make_pair(first, first),
+				[&](int x) {
+					const auto line = e.Line(x);
+					Value* outLine = writeLine(out, x);
+					std::pair<Value, Value> lineMinmax(first, first);
+					for (int y = 0; y < bounds.Y; y++)
+					{
+						const Value val = line[y];
+						outLine[y] = val;
+						lineMinmax.first = std::min(lineMinmax.first, val);
+						lineMinmax.second = std::max(lineMinmax.second, val);
+					}
+					return lineMinmax;
+				},
+				[](std::pair<Value, Value> a, std::pair<Value, Value> b) {
+					return std::make_pair(std::min(a.first, b.first), std::max(a.second, b.second));
+				});
+			const Value min = minmax.first;
+			const Value max = minmax.second;
+
+			// A flat map interpolates to newMin everywhere, as in Map::Interpolate
+			const Value oldRange = max - min;
+			const expr::ops::Rescale<Value> rescale = (oldRange == 0)
+				? expr::ops::Rescale<Value>{ min, 1, newMin, 0 }
+				: expr::ops::Rescale<Value>{ min, oldRange, newMin, newMax - newMin };
+
+			using Result = expr::Unary<expr::Terminal<Container>, expr::ops::Rescale<Value>>;
+			return MapExpr<Result>(Result(expr::Terminal<Container>(std::move(out)), rescale));
+		}
+
+	private:
+		E e;
+
+		template <typename Op>
+		UnaryExpr<Op> unary(Op op) const
+		{
+			return UnaryExpr<Op>(expr::Unary<E, Op>(e, op));
+		}
+
+		template <template <typename> class Op, typename R>
+		BinaryExpr<R, Op> binary(const R& rhs) const
+		{
+			return BinaryExpr<R, Op>(expr::Binary<E, R, Op<Value>>(e, rhs, Op<Value>{}));
+		}
+	};
+
+	//              //
+	// ENTRY POINTS //
+	//              //
+
+	inline MapExpr<expr::Terminal<Map>> Lazy(const Map& m)
+	{
+		return MapExpr<expr::Terminal<Map>>(expr::Terminal<Map>(m));
+	}
+
+	inline MapExpr<expr::Terminal<Map>> Lazy(Map&& m)
+	{
+		return MapExpr<expr::Terminal<Map>>(expr::Terminal<Map>(std::move(m)));
+	}
+
+	template <typename T>
+	MapExpr<expr::Terminal<MapT<T>>> Lazy(const MapT<T>& m)
+	{
+		return MapExpr<expr::Terminal<MapT<T>>>(expr::Terminal<MapT<T>>(m));
+	}
+
+	template <typename T>
+	MapExpr<expr::Terminal<MapT<T>>> Lazy(MapT<T>&& m)
+	{
+		return MapExpr<expr::Terminal<MapT<T>>>(expr::Terminal<MapT<T>>(std::move(m)));
+	}
+
+	// Math operator overloads
+
+	template <typename L, typename R>
+	auto operator+ (const MapExpr<L>& lhs, const MapExpr<R>& rhs) { return lhs.Add(rhs); }
+	template <typename L, typename R>
+	auto operator- (const MapExpr<L>& lhs, const MapExpr<R>& rhs) { return lhs.Sub(rhs); }
+	template <typename L, typename R>
+	auto operator* (const MapExpr<L>& lhs, const MapExpr<R>& rhs) { return lhs.Mul(rhs); }
+	template <typename L, typename R>
+	auto operator/ (const MapExpr<L>& lhs, const MapExpr<R>& rhs) { return lhs.Div(rhs); }
+
+	template <typename E>
+	auto operator+ (const MapExpr<E>& lhs, typename MapExpr<E>::Value val) { return lhs.Add(val); }
+	template <typename E>
+	auto operator- (const MapExpr<E>& lhs, typename MapExpr<E>::Value val) { return lhs.Sub(val); }
+	template <typename E>
+	auto operator* (const MapExpr<E>& lhs, typename MapExpr<E>::Value val) { return lhs.Mul(val); }
+	template <typename E>
+	auto operator/ (const MapExpr<E>& lhs, typename MapExpr<E>::Value val) { return lhs.Div(val); }
+
+	//            //
+	// ASSIGNMENT //
+	//            //
+
+	template <typename E>
+	inline Map& Map::operator= (const MapExpr<E>& expr)
+	{
+		if (bounds != expr.Bounds())
+		{
+			AllocData(expr.Bounds());
+			subMap = false;
+		}
+
+		expr.EvalTo(*this);
+		return *this;
+	}
+
+	template <typename T>
+	template <typename E>
+	inline void MapT<T>::operator= (const MapExpr<E>& expr)
+	{
+		if (bounds != expr.Bounds())
+		{
+			*this = MapT<T>(expr.Bounds());
+		}
+
+		expr.EvalTo(*this);
+	}
+} // namespace zmath
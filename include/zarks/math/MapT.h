@@ -1,15 +1,31 @@
 #pragma once
 
 #include <zarks/math/VecT.h>
+#include <zarks/math/Map.h>
 #include <zarks/internal/zmath_internals.h>
+#include <zarks/internal/parallel.h>
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <exception>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <utility>
 
-#define LOOP_MAP for (int x = 0; x < width; x++) for (int y = 0; y < height; y++) 
+// Loops over one x-line of the map, inside ForEachLine
+#define LOOP_LINE for (int y = 0; y < bounds.Y; y++)
 
 namespace zmath
 {
+	template <typename E>
+	class MapExpr;
+
+	// A grid of any element type. For arithmetic types it offers the same
+	// chainable API as Map; MapT<float> (Mapf) halves Map's memory and
+	// bandwidth and is accepted by Image and the float noise generators.
 	template <typename T>
 	class MapT
 	{
@@ -20,10 +36,14 @@ namespace zmath
 		MapT(MapT&& map);
 		~MapT();
 
+		// Conversion to and from Map, element by element
+		explicit MapT(const Map& map);
+		Map ToMap() const;
+
 		// Accessors
 
-		T* const& operator[](int x);
-		const T* const& operator[](int x) const;
+		T* operator[](int x);
+		const T* operator[](int x) const;
 
 		T& At(VecInt pt);
 		const T& At(VecInt pt) const;
@@ -35,9 +55,14 @@ namespace zmath
 
 		void operator= (const MapT& m);
 		void operator= (MapT&& m);
+		// Evaluates a lazy expression in a single sweep; see MapExpr.h
+		template <typename E>
+		void operator= (const MapExpr<E>& expr);
 
 		// Map characteristics
 
+		// As Map::Stats(), accumulated in double whatever T is
+		MapStats Stats() const;
 		T GetMin() const;
 		T GetMax() const;
 		std::pair<T, T> GetMinMax() const;
@@ -52,10 +77,18 @@ namespace zmath
 
 		// Chainable manipulation functions
 
-		MapT& Copy() const;
+		MapT Copy() const;
 		MapT& Clear(T val);
 		MapT& Interpolate(T newMin, T newMax);
 		MapT& Abs();
+		MapT& FillBorder(int thickness, T val);
+		MapT& Fill(VecInt min, VecInt max, T val);
+		MapT& Replace(T val, T with);
+		MapT& Apply(T(*calculation)(T));
+
+		MapT& BoundMax(T newMax);
+		MapT& BoundMin(T newMin);
+		MapT& Bound(T newMin, T newMax);
 
 		// Math operator overloads
 
@@ -79,12 +112,29 @@ namespace zmath
 		MapT& Mul(T val);
 		MapT& Div(T val);
 
+		MapT& Pow(T exp);
+
+		// Writes the same file format as Map::Save, widening values to double
+		void Save(std::string path) const;
+
 	private:
 		VecInt bounds;
-		int& width;
-		int& height;
-		T** data;
+		// Contiguous, aligned storage; element (x, y) is data[x * stride + y]
+		T* data;
+		int stride;
+
+		void boundAbort(const MapT& m) const;
 	};
+
+	typedef MapT<float> Mapf;
+
+	// The MapT counterpart of writeLine(Map&, int), so generic code can use
+	// either; MapT keeps no stats cache, so this is just operator[]
+	template <typename T>
+	T* writeLine(MapT<T>& map, int x)
+	{
+		return map[x];
+	}
 }
 
 //                //
@@ -96,11 +146,12 @@ namespace zmath
 
 template<typename T>
 inline MapT<T>::MapT(VecInt bounds)
-	: bounds(bounds)
-	, width(bounds.X)
-	, height(bounds.Y)
-	, data(alloc2d<T>(bounds.X, bounds.Y))
-{}
+	: bounds(VecInt::Max(bounds, VecInt(0, 0)))
+	, data(nullptr)
+	, stride(alignedStride<T>(this->bounds.Y))
+{
+	data = allocAligned<T>((size_t)this->bounds.X * stride);
+}
 
 template<typename T>
 inline MapT<T>::MapT(int x, int y)
@@ -116,25 +167,49 @@ inline MapT<T>::MapT(const MapT& map)
 
 template<typename T>
 inline MapT<T>::MapT(MapT&& map)
-	: MapT(map)
-{}
+	: bounds(map.bounds)
+	, data(map.data)
+	, stride(map.stride)
+{
+	map.bounds = VecInt(0, 0);
+	map.data = nullptr;
+	map.stride = 0;
+}
 
 template<typename T>
 inline MapT<T>::~MapT()
 {
-	free2d<T>(data, width);
+	freeAligned<T>(data, (size_t)bounds.X * stride);
 }
 
 template<typename T>
-inline T* const& MapT<T>::operator[](int x)
+inline MapT<T>::MapT(const Map& map)
+	: MapT(map.Bounds())
 {
-	return data[x];
+	ForEachLine(bounds, [&](int x) { LOOP_LINE (*this)[x][y] = (T)map[x][y]; });
 }
 
 template<typename T>
-inline const T* const& MapT<T>::operator[](int x) const
+inline Map MapT<T>::ToMap() const
 {
-	return data[x];
+	Map map(bounds);
+	ForEachLine(bounds, [&](int x) {
+		double* line = writeLine(map, x);
+		LOOP_LINE line[y] = (double)(*this)[x][y];
+	});
+	return map;
+}
+
+template<typename T>
+inline T* MapT<T>::operator[](int x)
+{
+	return data + (size_t)x * stride;
+}
+
+template<typename T>
+inline const T* MapT<T>::operator[](int x) const
+{
+	return data + (size_t)x * stride;
 }
 
 template<typename T>
@@ -158,7 +233,7 @@ inline T& MapT<T>::At(int x, int y)
 		throw std::runtime_error("Tried to access MapT out of bounds!");
 	}
 
-	return data[x][y];
+	return (*this)[x][y];
 }
 
 template<typename T>
@@ -170,7 +245,7 @@ inline const T& MapT<T>::At(int x, int y) const
 		throw std::runtime_error("Tried to access MapT out of bounds!");
 	}
 
-	return data[x][y];
+	return (*this)[x][y];
 }
 
 template<typename T>
@@ -188,63 +263,122 @@ inline void MapT<T>::Set(int x, int y, T val)
 		throw std::runtime_error("Tried to access MapT out of bounds!");
 	}
 
-	return data[x][y] = val;
+	(*this)[x][y] = val;
 }
 
 template<typename T>
 inline void MapT<T>::operator= (const MapT& m)
 {
-	bounds = m.bounds;
-	LOOP_MAP
+	if (this == &m) return;
+
+	if (bounds != m.bounds)
 	{
-		data[x][y] = m[x][y];
+		freeAligned<T>(data, (size_t)bounds.X * stride);
+		bounds = m.bounds;
+		stride = alignedStride<T>(bounds.Y);
+		data = allocAligned<T>((size_t)bounds.X * stride);
 	}
+
+	ForEachLine(bounds, [&](int x) { std::copy(m[x], m[x] + bounds.Y, (*this)[x]); });
 }
 
 template<typename T>
 inline void MapT<T>::operator= (MapT&& m)
 {
-	*this = m;
+	std::swap(bounds, m.bounds);
+	std::swap(data, m.data);
+	std::swap(stride, m.stride);
 }
 
 template<typename T>
-inline T MapT<T>::GetMin() const
+inline void MapT<T>::boundAbort(const MapT& m) const
 {
-	T min = data[0][0];
+	if (bounds != m.bounds) throw std::runtime_error("Map bounds don't match!");
+}
 
-	LOOP_MAP
-	{
-		min = (data[x][y] < min) ? data[x][y] : min;
-	}
+template<typename T>
+inline MapStats MapT<T>::Stats() const
+{
+	MapStats result = {};
+	if (bounds.Area() == 0) return result;
 
-	return min;
+	// Per-line two-pass count, mean and M2 in double, merged as in Map::Stats()
+	struct Partial {
+		double count, min, max, sum, mean, m2;
+	};
+
+	const double first = (double)(*this)[0][0];
+	const Partial total = ReduceLines(bounds, Partial{ 0, first, first, 0, 0, 0 },
+		[&](int x) {
+			const T* line = (*this)[x];
+			Partial p{ (double)bounds.Y, first, first, 0, 0, 0 };
+			LOOP_LINE
+			{
+				const double v = (double)line[y];
+				p.min = std::min(p.min, v);
+				p.max = std::max(p.max, v);
+				p.sum += v;
+			}
+			p.mean = p.sum / p.count;
+			LOOP_LINE
+			{
+				const double d = (double)line[y] - p.mean;
+				p.m2 += d * d;
+			}
+			return p;
+		},
+		[](const Partial& a, const Partial& b) {
+			Partial ab;
+			ab.count = a.count + b.count;
+			ab.min = std::min(a.min, b.min);
+			ab.max = std::max(a.max, b.max);
+			ab.sum = a.sum + b.sum;
+
+			const double delta = b.mean - a.mean;
+			ab.mean = a.mean + delta * b.count / ab.count;
+			ab.m2 = a.m2 + b.m2 + delta * delta * a.count * b.count / ab.count;
+			return ab;
+		});
+
+	result.min = total.min;
+	result.max = total.max;
+	result.sum = total.sum;
+	result.mean = total.sum / total.count;
+	result.variance = total.m2 / (total.count - 1);
+	result.stdDev = std::sqrt(result.variance);
+	return result;
 }
 
 template<typename T>
-inline T MapT<T>::GetMax() const
+inline T MapT<T>::GetMin() const
 {
-	T max = data[0][0];
-
-	LOOP_MAP
-	{
-		max = (data[x][y] > max) ? data[x][y] : max;
-	}
+	return GetMinMax().first;
+}
 
-	return max;
+template<typename T>
+inline T MapT<T>::GetMax() const
+{
+	return GetMinMax().second;
 }
 
 template<typename T>
 inline std::pair<T, T> MapT<T>::GetMinMax() const
 {
-	std::pair<T, T> minmax{ data[0][0], data[0][0] };
-
-	LOOP_MAP
-	{
-		minmax.first = (data[x][y] < minmax.first) ? data[x][y] : minmax.first;
-		minmax.second = (data[x][y] > minmax.second) ? data[x][y] : minmax.second;
-	}
+	const T first = (*this)[0][0];
 
-	return minmax;
+	return ReduceLines(bounds, std::make_pair(first, first),
+		[&](int x) {
+			auto minmax = std::make_pair(first, first);
+			LOOP_LINE
+			{
+				minmax.first = std::min(minmax.first, (*this)[x][y]);
+				minmax.second = std::max(minmax.second, (*this)[x][y]);
+			}
+			return minmax;
+		},
+		[](std::pair<T, T> a, std::pair<T, T> b) {
+			return std::make_pair(std::min(a.first, b.first), std::max(a.second, b.second));
+		});
 }
 
 template<typename T>
@@ -256,93 +390,137 @@ inline VecInt MapT<T>::Bounds() const
 template<typename T>
 inline T MapT<T>::Sum() const
 {
-	T sum = T();
-
-	LOOP_MAP
-	{
-		sum += data[x][y];
-	}
-
-	return sum;
+	return (T)Stats().sum;
 }
 
 template<typename T>
 inline T MapT<T>::Mean() const
 {
-	return Sum() / (bounds.X * bounds.Y - 1);
+	return (T)Stats().mean;
 }
 
 template<typename T>
 inline T MapT<T>::Variance() const
 {
-	T mean = Mean();
-	T sumDiffs = T();
-
-	LOOP_MAP
-	{
-		T diff = AbsT(data[x][y] - mean);
-		sumDiffs += diff * diff;
-	}
-
-	return sumDiffs / (bounds.X * bounds.Y - 1);
+	return (T)Stats().variance;
 }
 
 template<typename T>
 inline T MapT<T>::Std() const
 {
-	return std::sqrt(Variance());
+	return (T)Stats().stdDev;
 }
 
 template<typename T>
 inline bool MapT<T>::ContainsCoord(VecInt pos) const
 {
-	return pos > VecInt(0, 0) && pos < bounds;
+	return pos >= VecInt(0, 0) && pos < bounds;
 }
 
 // Chainable manipulation functions
 
 template<typename T>
-inline MapT<T>& MapT<T>::Copy() const
+inline MapT<T> MapT<T>::Copy() const
 {
-	MapT<T>* m = new MapT<T>(*this);
-	return *m;
+	return MapT<T>(*this);
 }
 
 template<typename T>
 inline MapT<T>& MapT<T>::Clear(T val)
 {
-	LOOP_MAP
-	{
-		data[x][y] = val;
-	}
-
+	ForEachLine(bounds, [&](int x) { std::fill((*this)[x], (*this)[x] + bounds.Y, val); });
 	return *this;
 }
 
 template<typename T>
 inline MapT<T>& MapT<T>::Interpolate(T newMin, T newMax)
 {
-	std::pair<T, T> oldMinMax = GetMinMax();
-	T oldRange = oldMinMax.second - oldMinMax.first;
-	T newRange = newMax - newMin;
-	T scale = newRange / oldRange;
-
-	LOOP_MAP
+	const std::pair<T, T> old = GetMinMax();
+	const T oldRange = old.second - old.first;
+	if (oldRange == 0)
 	{
-		data[x][y] = (data[x][y] - oldMinMax.first) * scale + newMax;
+		return Clear(newMin);
 	}
 
+	const T newRange = newMax - newMin;
+
+	ForEachLine(bounds, [&](int x) {
+		LOOP_LINE (*this)[x][y] = ((*this)[x][y] - old.first) / oldRange * newRange + newMin;
+	});
+
 	return *this;
 }
 
 template<typename T>
 inline MapT<T>& MapT<T>::Abs()
 {
-	LOOP_MAP
+	ForEachLine(bounds, [&](int x) { LOOP_LINE (*this)[x][y] = AbsT((*this)[x][y]); });
+	return *this;
+}
+
+template<typename T>
+inline MapT<T>& MapT<T>::FillBorder(int thickness, T val)
+{
+	thickness = std::min(thickness, bounds.Min());
+	// Left
+	Fill({ 0, 0 }, { thickness, bounds.Y }, val);
+	// Right
+	Fill({ bounds.X - thickness, 0 }, { bounds.X, bounds.Y }, val);
+	// Top (no corners)
+	Fill({ thickness, bounds.Y - thickness }, { bounds.X - thickness, bounds.Y }, val);
+	// Bottom (no corners)
+	Fill({ thickness, 0 }, { bounds.X - thickness, thickness }, val);
+	return *this;
+}
+
+template<typename T>
+inline MapT<T>& MapT<T>::Fill(VecInt min, VecInt max, T val)
+{
+	for (int x = min.X; x < max.X; x++)
 	{
-		data[x][y] = AbsT(data[x][y]);
+		for (int y = min.Y; y < max.Y; y++)
+		{
+			(*this)[x][y] = val;
+		}
 	}
+	return *this;
+}
 
+template<typename T>
+inline MapT<T>& MapT<T>::Replace(T val, T with)
+{
+	ForEachLine(bounds, [&](int x) { LOOP_LINE if ((*this)[x][y] == val) (*this)[x][y] = with; });
+	return *this;
+}
+
+// Under Exec::Parallel, 'calculation' is called from several threads at once
+template<typename T>
+inline MapT<T>& MapT<T>::Apply(T(*calculation)(T))
+{
+	ForEachLine(bounds, [&](int x) { LOOP_LINE (*this)[x][y] = calculation((*this)[x][y]); });
+	return *this;
+}
+
+template<typename T>
+inline MapT<T>& MapT<T>::BoundMax(T newMax)
+{
+	ForEachLine(bounds, [&](int x) { LOOP_LINE (*this)[x][y] = std::min(newMax, (*this)[x][y]); });
+	return *this;
+}
+
+template<typename T>
+inline MapT<T>& MapT<T>::BoundMin(T newMin)
+{
+	ForEachLine(bounds, [&](int x) { LOOP_LINE (*this)[x][y] = std::max(newMin, (*this)[x][y]); });
+	return *this;
+}
+
+template<typename T>
+inline MapT<T>& MapT<T>::Bound(T newMin, T newMax)
+{
+	ForEachLine(bounds, [&](int x) {
+		LOOP_LINE (*this)[x][y] = std::min(newMax, std::max(newMin, (*this)[x][y]));
+	});
 	return *this;
 }
 
@@ -351,80 +529,75 @@ inline MapT<T>& MapT<T>::Abs()
 template<typename T>
 inline MapT<T>& MapT<T>::operator+= (const MapT& m)
 {
-	LOOP_MAP
-	{
-		data[x][y] += m[x][y];
-	}
+	boundAbort(m);
+	ForEachLine(bounds, [&](int x) { LOOP_LINE (*this)[x][y] += m[x][y]; });
 	return *this;
 }
 
 template<typename T>
 inline MapT<T>& MapT<T>::operator-= (const MapT& m)
 {
-	LOOP_MAP
-	{
-		data[x][y] -= m[x][y];
-	}
+	boundAbort(m);
+	ForEachLine(bounds, [&](int x) { LOOP_LINE (*this)[x][y] -= m[x][y]; });
 	return *this;
 }
 
 template<typename T>
 inline MapT<T>& MapT<T>::operator*= (const MapT& m)
 {
-	LOOP_MAP
-	{
-		data[x][y] *= m[x][y];
-	}
+	boundAbort(m);
+	ForEachLine(bounds, [&](int x) { LOOP_LINE (*this)[x][y] *= m[x][y]; });
 	return *this;
 }
 
+// As with Map, division by zero saturates to the largest value of the right sign
 template<typename T>
 inline MapT<T>& MapT<T>::operator/= (const MapT& m)
 {
-	LOOP_MAP
-	{
-		data[x][y] /= m[x][y];
-	}
+	boundAbort(m);
+	ForEachLine(bounds, [&](int x) {
+		LOOP_LINE
+		{
+			T& val = (*this)[x][y];
+			if (m[x][y] == 0)
+			{
+				if (val > 0) val = std::numeric_limits<T>::max();
+				else if (val < 0) val = std::numeric_limits<T>::lowest();
+			}
+			else
+			{
+				val /= m[x][y];
+			}
+		}
+	});
 	return *this;
 }
 
 template<typename T>
 inline MapT<T>& MapT<T>::operator+= (T val)
 {
-	LOOP_MAP
-	{
-		data[x][y] += val;
-	}
+	ForEachLine(bounds, [&](int x) { LOOP_LINE (*this)[x][y] += val; });
 	return *this;
 }
 
 template<typename T>
 inline MapT<T>& MapT<T>::operator-= (T val)
 {
-	LOOP_MAP
-	{
-		data[x][y] -= val;
-	}
+	ForEachLine(bounds, [&](int x) { LOOP_LINE (*this)[x][y] -= val; });
 	return *this;
 }
 
 template<typename T>
 inline MapT<T>& MapT<T>::operator*= (T val)
 {
-	LOOP_MAP
-	{
-		data[x][y] *= val;
-	}
+	ForEachLine(bounds, [&](int x) { LOOP_LINE (*this)[x][y] *= val; });
 	return *this;
 }
 
 template<typename T>
 inline MapT<T>& MapT<T>::operator/= (T val)
 {
-	LOOP_MAP
-	{
-		data[x][y] /= val;
-	}
+	if (val != 0) ForEachLine(bounds, [&](int x) { LOOP_LINE (*this)[x][y] /= val; });
 	return *this;
 }
 
@@ -454,6 +627,59 @@ inline MapT<T>& MapT<T>::Mul(T val) { return (*this) *= val; }
 template<typename T>
 inline MapT<T>& MapT<T>::Div(T val) { return (*this) /= val; }
 
+template<typename T>
+inline MapT<T>& MapT<T>::Pow(T exp)
+{
+	if (exp == 1) return *this;
+	if (exp == 2) return Mul(*this);
+
+	ForEachLine(bounds, [&](int x) { LOOP_LINE (*this)[x][y] = std::pow((*this)[x][y], exp); });
+	return *this;
+}
+
+template<typename T>
+inline void MapT<T>::Save(std::string path) const
+{
+	std::ofstream file;
+
+	file.open(path, std::ios::binary | std::ios::out);
+
+	uint8_t header[64] = {};
+	uint8_t boundX[4];
+	uint8_t boundY[4];
+
+	uint32_t uintX = bounds.X;
+	uint32_t uintY = bounds.Y;
+
+	// little-endian encoding
+	for (int i = 0; i < 4; i++)
+	{
+		boundX[i] = uintX >> (8 * i);
+		boundY[i] = uintY >> (8 * i);
+	}
+
+	// Write the intro data
+	file.write((char*)header, sizeof(header));
+	file.write((char*)boundX, sizeof(boundX));
+	file.write((char*)boundY, sizeof(boundY));
+
+	// Write the actual map data as doubles, little-endian
+	for (int x = 0; x < bounds.X; x++)
+	{
+		LOOP_LINE
+		{
+			const double valDouble = (double)(*this)[x][y];
+			uint64_t val;
+			std::memcpy(&val, &valDouble, sizeof(val));
+
+			uint8_t arr[8];
+			for (int i = 0; i < 8; i++) arr[i] = val >> (8 * i);
+
+			file.write((char*)arr, sizeof(arr));
+		}
+	}
+}
+
 } // namespace zmath
 
-#undef LOOP_MAP
+#undef LOOP_LINE
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <zarks/math/VecT.h>
+#include <zarks/math/Rect.h>
+#include <zarks/math/Map.h>
+
+#include <vector>
+
+namespace zmath
+{
+	class Image;
+
+	// A summed-area table (integral image) of a Map, or of each RGBA channel
+	// of an Image. Once built, the sum, mean and variance of any rectangle
+	// cost four lookups each, whatever its size.
+	//
+	// Rects select the pixels p with min <= p < max, clipped to the source's
+	// bounds, so Rect(VecInt(x0, y0), VecInt(x1, y1)) covers x0..x1-1 and
+	// y0..y1-1. Channels are numbered as in RGBA::operator[]; a Map has one.
+	class SummedArea
+	{
+	public:
+		// Builds the table in one parallel sweep. Without 'squares', the sums
+		// of squared values are skipped, halving memory, and Variance() throws.
+		SummedArea(const Map& map, bool squares = true);
+		SummedArea(const Image& img, bool squares = true);
+
+		VecInt Bounds() const;
+		int Channels() const;
+
+		// The number of pixels of 'rect' inside the source
+		int Count(Rect rect) const;
+
+		double Sum(Rect rect, int channel = 0) const;
+		// Mean and sample variance, as in Map::Mean() and Map::Variance().
+		// Both are 0 for a rect with too few pixels.
+		double Mean(Rect rect, int channel = 0) const;
+		double Variance(Rect rect, int channel = 0) const;
+
+		// The window of the given radius around a pixel, (2 * radius + 1)
+		// pixels wide before clipping
+		static Rect Window(VecInt center, int radius);
+
+	private:
+		VecInt bounds;
+		int channels;
+		bool hasSquares;
+
+		// Entry (x, y) holds the totals over [0, x) x [0, y), of each value
+		// less its channel's reference; see index() and build()
+		std::vector<double> reference;
+		std::vector<double> sums;
+		std::vector<double> squares;
+
+		SummedArea(VecInt bounds, int channels, bool squares);
+
+		template <typename Value>
+		void build(Value value);
+
+		size_t index(int x, int y, int channel) const;
+		double total(const std::vector<double>& table, VecInt min, VecInt max, int channel) const;
+		bool clip(Rect rect, VecInt& min, VecInt& max) const;
+	};
+}
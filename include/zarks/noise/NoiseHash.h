@@ -2,32 +2,57 @@
 
 #include <zarks/internal/noise_internals.h>
 
-#include <random>
-#include <unordered_map>
+#include <array>
+#include <cstdint>
 
 namespace zmath
 {
+    // A stateless gradient lattice. The unit vector at a lattice point is
+    // picked from a fixed table by a counter-based hash of (x, y, octave)
+    // keyed on the seed (see hashLattice), so lookups need no memory, never
+    // allocate, and may be made from any number of threads at once.
     class NoiseHash
     {
     public:
-        NoiseHash(uint64_t seed = 0);
-
-        bool Exists(VecInt key) const;
-        Vec& Create(VecInt key, Vec val);
-        Vec& Create(VecInt key);
+        NoiseHash(uint64_t seed = RANDOM_SEED);
 
+        // Moves on to the next octave, whose gradients are unrelated to the
+        // current ones. Nothing needs to be freed.
         void Clear();
 
-        Vec& operator[](VecInt key);
+        int Octave() const;
+        void SetOctave(int octave);
+        uint64_t Seed() const;
+
+        // Gradient at a lattice point in the current octave
+        Vec operator[](VecInt key) const;
 
-        Vec& At(VecInt key);
-        const Vec& At(VecInt key) const;
+        Vec At(VecInt key) const;
+        Vec At(VecInt key, int octave) const;
 
         static constexpr uint64_t RANDOM_SEED = 0;
+        static constexpr int GRADIENTS = 256;
 
     private:
-        std::unordered_map<VecInt, Vec> hash;
-        std::default_random_engine eng;
-        std::uniform_real_distribution<double> angleRNG;
+        uint64_t seed;
+        uint64_t seedKey; // the seed, pre-mixed
+        int octave;
+
+        static const std::array<Vec, GRADIENTS> gradients;
     };
+
+    inline Vec NoiseHash::operator[](VecInt key) const
+    {
+        return At(key, octave);
+    }
+
+    inline Vec NoiseHash::At(VecInt key) const
+    {
+        return At(key, octave);
+    }
+
+    inline Vec NoiseHash::At(VecInt key, int octave) const
+    {
+        return gradients[hashLattice(key.X, key.Y, octave, seedKey) % GRADIENTS];
+    }
 } // namespace zmath
@@ -3,29 +3,167 @@
 #include <zarks/math/Map.h>
 #include <zarks/noise/NoiseHash.h>
 #include <zarks/internal/noise_internals.h>
+#include <zarks/internal/noise_points.h>
+#include <zarks/internal/parallel.h>
+#include <zarks/internal/progress.h>
 
+#include <cmath>
+#include <cstddef>
+#include <vector>
 #include <unordered_map>
-#include <random>
 
 namespace zmath
 {
+    // Evaluates noise at a single point
+    typedef double (*NoisePointFunc)(Vec coord, NoiseHash& hash);
+    // Evaluates noise at the n points (xs[i], ys[i]), writing the results to out
+    typedef void (*NoiseBatchFunc)(const double* xs, const double* ys, double* out, size_t n, const NoiseHash& hash);
+
+    // Under Exec::Parallel (the default), a Noiser or NoiserT calls its noise
+    // function from several pool threads at once, one band of x-lines each.
+    // User functions must therefore be thread-safe: any state they touch
+    // other than their arguments must be read-only or synchronized. Each
+    // call's 'hash' is private to the line being filled. Use ExecScope with
+    // Exec::Serial to run a function that can't meet this.
+
     class Noiser
     {
     public:
-        Noiser(double (*noiseFunc)(Vec, NoiseHash&), uint64_t seed = NoiseHash::RANDOM_SEED);
+        Noiser(NoisePointFunc noiseFunc, uint64_t seed = NoiseHash::RANDOM_SEED);
+        Noiser(NoiseBatchFunc batchFunc, uint64_t seed = NoiseHash::RANDOM_SEED);
 
-        Map operator()(VecInt dimensions, int octaves, bool interpolate = true);
+        Map operator()(VecInt dimensions, int octaves, bool interpolate = true, const ProgressFn& progressFn = ProgressFn());
         void AddOctave(Map& map, int octave);
 
     private:
         // Hash map to keep track of all vectors in the current octave
         NoiseHash hash;
         // The noise function to call on each pixel
-        double (*noiseFunc)(Vec, NoiseHash&);
-        // RNG
-        std::default_random_engine eng;
+        NoisePointFunc noiseFunc;
+        // The noise function to call on each line of pixels, if there is one
+        NoiseBatchFunc batchFunc;
+
+        // Coordinates and results of a batched line, allocated once per band
+        typedef struct LineBuffers {
+            std::vector<double> xs, ys, out;
+        } LineBuffers;
+
+        // Adds one octave of noise to the x-line 'line' of a map
+        void addLine(double* line, int x, VecInt dim, int octave, NoiseHash octaveHash, LineBuffers& buffers) const;
     };
 
     double SimplexPoint(Vec coord, NoiseHash& hash);
     double PerlinPoint(Vec coord, NoiseHash& hash);
+
+    // Batched versions of the above, using SSE2 or AVX2 where available and
+    // giving the same results as the single-point functions. Coordinates
+    // must lie within the range of an int. A Noiser built from SimplexPoint
+    // or PerlinPoint uses these automatically.
+    void SimplexPoints(const double* xs, const double* ys, double* out, size_t n, const NoiseHash& hash);
+    void PerlinPoints(const double* xs, const double* ys, double* out, size_t n, const NoiseHash& hash);
+
+    // SimplexPoint and PerlinPoint as function objects, for NoiserT
+    typedef struct SimplexFunc {
+        double operator()(Vec coord, const NoiseHash& hash) const
+        {
+            return points::simplexPoint(coord.X, coord.Y, hash);
+        }
+    } SimplexFunc;
+
+    typedef struct PerlinFunc {
+        double operator()(Vec coord, const NoiseHash& hash) const
+        {
+            return points::perlinPoint(coord.X, coord.Y, hash);
+        }
+    } PerlinFunc;
+
+    // Noiser with its noise function fixed at compile time. F is any type
+    // callable as 'double (Vec coord, const NoiseHash& hash) const', such as
+    // SimplexFunc or a lambda; being a type rather than a pointer, its calls
+    // are inlined into the per-pixel loop. Maps match those of a Noiser built
+    // from the equivalent function. The one 'func' is shared by every thread,
+    // so its operator() must be thread-safe, as above.
+    template <typename F>
+    class NoiserT
+    {
+    public:
+        NoiserT(uint64_t seed = NoiseHash::RANDOM_SEED, F func = F());
+
+        Map operator()(VecInt dimensions, int octaves, bool interpolate = true, const ProgressFn& progressFn = ProgressFn());
+        void AddOctave(Map& map, int octave);
+
+    private:
+        NoiseHash hash;
+        F func;
+
+        void addLine(double* line, int x, VecInt dim, int octave, const NoiseHash& octaveHash) const;
+    };
+
+    //         //
+    // NoiserT //
+    //         //
+
+    template <typename F>
+    inline NoiserT<F>::NoiserT(uint64_t seed, F func)
+        : hash(seed)
+        , func(func)
+    {}
+
+    template <typename F>
+    inline Map NoiserT<F>::operator()(VecInt dimensions, int octaves, bool interpolate, const ProgressFn& progressFn)
+    {
+        Progress progress(progressFn, "Noiser", dimensions.X);
+
+        Map map(dimensions);
+
+        std::vector<NoiseHash> hashes;
+        for (int oct = 0; oct < octaves; oct++)
+        {
+            hash.Clear();
+            hashes.push_back(hash);
+        }
+
+        ForEachLine(dimensions, [&](int x) {
+            if (progress.Stopped()) return;
+
+            double* line = writeLine(map, x);
+            for (int oct = 0; oct < octaves; oct++)
+            {
+                addLine(line, x, dimensions, oct, hashes[oct]);
+            }
+
+            progress.Step();
+        });
+        progress.Finish();
+
+        if (interpolate)
+        {
+            map.Interpolate(0, 1);
+        }
+
+        return map;
+    }
+
+    template <typename F>
+    inline void NoiserT<F>::AddOctave(Map& map, int octave)
+    {
+        hash.Clear();
+
+        const VecInt dim = map.Bounds();
+        ForEachLine(dim, [&](int x) { addLine(writeLine(map, x), x, dim, octave, hash); });
+    }
+
+    template <typename F>
+    inline void NoiserT<F>::addLine(double* line, int x, VecInt dim, int octave, const NoiseHash& octaveHash) const
+    {
+        const double octPow = std::pow(2, octave);
+        const double octInfluence = 1.0 / octPow;
+        const Vec scale = Vec(octPow, octPow) / Vec(dim);
+
+        for (int y = 0; y < dim.Y; y++)
+        {
+            const Vec point = Vec(x, y) * scale;
+            line[y] += octInfluence * func(point, octaveHash);
+        }
+    }
 }
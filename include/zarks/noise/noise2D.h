@@ -1,9 +1,14 @@
 #pragma once
 
 #include <zarks/math/Map.h>
+#include <zarks/math/MapT.h>
+#include <zarks/math/Rect.h>
+#include <zarks/internal/progress.h>
 
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <vector>
 
 namespace zmath
 {
@@ -33,6 +38,10 @@ namespace zmath
 
 		// Worley-specific values
 		std::pair<int, int> nearest;
+
+		// Called as lines are generated; silent unless set. Generation
+		// throws Cancelled if it returns false.
+		ProgressFn progress;
 	} NoiseConfig;
 
 	Map Simplex(const NoiseConfig& cfg);
@@ -40,4 +49,89 @@ namespace zmath
 	Map Worley(const NoiseConfig& cfg);
 
 	Map WorleyPlex(const NoiseConfig& cfg, const Map& baseMap);
+
+	// Chunked generation. Each noise type is one infinite field per seed, and
+	// these generate the cfg.bounds pixels of it starting at 'origin', so a
+	// tile is identical to the same region of one larger map. The Rect
+	// overloads cover the pixels of 'region', rounded outwards, instead of
+	// cfg.bounds. Normalization rescales each tile by its own range, so leave
+	// cfg.normalize off for tiles that need to line up.
+	Map Simplex(const NoiseConfig& cfg, VecInt origin);
+	Map Perlin(const NoiseConfig& cfg, VecInt origin);
+	Map Worley(const NoiseConfig& cfg, VecInt origin);
+	Map Simplex(const NoiseConfig& cfg, const Rect& region);
+	Map Perlin(const NoiseConfig& cfg, const Rect& region);
+	Map Worley(const NoiseConfig& cfg, const Rect& region);
+
+	// 'baseMap' covers the tile, not the whole world
+	Map WorleyPlex(const NoiseConfig& cfg, const Map& baseMap, VecInt origin);
+
+	// Single-precision output, at half the memory of a Map. Values are
+	// computed in double and stored as float; normalization happens in float.
+	Mapf Simplexf(const NoiseConfig& cfg, VecInt origin = VecInt(0, 0));
+	Mapf Perlinf(const NoiseConfig& cfg, VecInt origin = VecInt(0, 0));
+	Mapf Worleyf(const NoiseConfig& cfg, VecInt origin = VecInt(0, 0));
+
+	// A noise map with its exact partial derivatives, in value per pixel.
+	// When cfg.normalize is set the derivatives are scaled to match.
+	typedef struct NoiseGradient {
+		NoiseGradient(VecInt bounds);
+
+		Map value;
+		Map dx;
+		Map dy;
+
+		// Magnitude of the gradient at each pixel; an exact SlopeMap()
+		Map Slope() const;
+	} NoiseGradient;
+
+	// Simplex and Perlin noise along with their derivatives, computed in the
+	// same pass. 'value' is identical to Simplex(cfg, origin)/Perlin(cfg, origin).
+	NoiseGradient SimplexGradient(const NoiseConfig& cfg, VecInt origin = VecInt(0, 0));
+	NoiseGradient PerlinGradient(const NoiseConfig& cfg, VecInt origin = VecInt(0, 0));
+
+	enum class NoiseType {
+		Simplex,
+		Perlin,
+		Worley,
+	};
+
+	// Receives the map generated for seeds[index] by GenerateBatch. The map is
+	// reused once this returns, so copy it to keep it. Calls for different
+	// seeds may run at the same time on different threads.
+	typedef std::function<void(size_t index, int64_t seed, const Map& map)> BatchFn;
+
+	// Generates a map for every seed, all else as in 'cfg', handing each to
+	// 'fn' as soon as it is done. Seeds are spread over the library's threads
+	// (see SetExec), each reusing one map for all of its seeds. cfg.progress
+	// reports over the whole batch and can cancel it between maps.
+	void GenerateBatch(NoiseType type, const NoiseConfig& cfg, const std::vector<int64_t>& seeds, const BatchFn& fn);
+
+	// Keeps each octave of one noise type as an unweighted layer, so a map
+	// that differs from an earlier one only in octDecrease, octaves or
+	// normalize is just a weighted sum of layers already generated. Only
+	// octaves not seen before are computed, and maps are identical to those
+	// of the uncached generators. Layers are kept for one set of the other
+	// inputs (seed, bounds, boxSize, origin and the type's own parameters);
+	// changing any of them starts over. Perlin box sizes shrink with
+	// octDecrease, so for Perlin that is one of the other inputs too.
+	class OctaveCache
+	{
+	public:
+		OctaveCache(NoiseType type);
+
+		Map operator()(const NoiseConfig& cfg, VecInt origin = VecInt(0, 0));
+
+		// Number of octaves currently cached
+		int Layers() const;
+		void Clear();
+
+	private:
+		NoiseType type;
+		NoiseConfig layerCfg;
+		VecInt layerOrigin;
+		std::vector<Map> layers;
+
+		bool matches(const NoiseConfig& cfg, VecInt origin) const;
+	};
 }
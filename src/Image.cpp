@@ -1,7 +1,8 @@
 #include <zarks/image/Image.h>
 #include <zarks/internal/zmath_internals.h>
-#include <zarks/math/MapT.h>
+#include <zarks/internal/resample.h>
 #include <zarks/math/GaussField.h>
+#include <zarks/math/SummedArea.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
@@ -10,11 +11,17 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb/stb_image_write.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <vector>
 
 #define LOOP_IMAGE for (int x = 0; x < bounds.X; x++) for (int y = 0; y < bounds.Y; y++)
-#define LOOP_IMAGE_HORIZONTAL for (int y = 0; y < bounds.Y; y++) for (int x = 0; x < bounds.X; x++)
+// Loops over one x-line of the image. Per-pixel work goes through ForEachLine so
+// that lines are spread over threads according to the execution policy.
+#define LOOP_LINE for (int y = 0; y < bounds.Y; y++)
 
 using namespace zmath;
 
@@ -29,19 +36,57 @@ Image::Image(zmath::VecInt bounds_in, RGBA col)
 	: Image(bounds_in.X, bounds_in.Y, col)
 {}
 
-Image::Image(const zmath::Map& m)
-	: Image(m.Bounds())
+// Shared by the Map and Mapf constructors
+namespace
+{
+
+// Rounds and clamps a filtered channel value
+uint8 toChannel(double v)
 {
-	LOOP_IMAGE
+	return (uint8)std::min(255.0, std::max(0.0, std::round(v)));
+}
+
+// stb's images are row-major while x-lines run down the columns, so
+// converting between them is a transpose
+static_assert(sizeof(RGBA) == 4, "RGBA must match stb's 4-byte pixels");
+
+// Calls f(x, y) for every pixel in [min, max), in square tiles, so that both
+// the x-lines and a row-major buffer are walked a cache line at a time
+constexpr int TRANSPOSE_TILE = 32;
+
+template <typename F>
+void forEachTile(VecInt min, VecInt max, F&& f)
+{
+	for (int x0 = min.X; x0 < max.X; x0 += TRANSPOSE_TILE)
 	{
-		uint8 shade = 255.999 * m[x][y];
-		data[x][y] = RGBA(shade, shade, shade);
+		for (int y0 = min.Y; y0 < max.Y; y0 += TRANSPOSE_TILE)
+		{
+			const int x1 = std::min(max.X, x0 + TRANSPOSE_TILE);
+			const int y1 = std::min(max.Y, y0 + TRANSPOSE_TILE);
+			for (int y = y0; y < y1; y++)
+				for (int x = x0; x < x1; x++) f(x, y);
+		}
 	}
 }
 
-Image::Image(const zmath::Map& m, Scheme scheme)
-	: Image(m.Bounds())
+template <typename M>
+void fromMap(Image& img, const M& m)
 {
+	const VecInt bounds = img.Bounds();
+	ForEachLine(bounds, [&](int x) {
+		LOOP_LINE
+		{
+			uint8 shade = 255.999 * m[x][y];
+			img[x][y] = RGBA(shade, shade, shade);
+		}
+	});
+}
+
+template <typename M>
+void fromMap(Image& img, const M& m, const Scheme& scheme)
+{
+	const VecInt bounds = img.Bounds();
+
 	// Create an accurate thresholds array
 	std::vector<double> thresholds(scheme.colors.size());
 	thresholds.back() = 1;
@@ -51,92 +96,81 @@ Image::Image(const zmath::Map& m, Scheme scheme)
 	}
 
 	// Loop and assign colors
-	LOOP_IMAGE
-	{
-		double val = m[x][y];
-
-		int idxUpper = 0;
-		for (unsigned i = 0; i < scheme.colors.size(); i++)
+	ForEachLine(bounds, [&](int x) {
+		LOOP_LINE
 		{
-			if (val < thresholds[i])
+			double val = m[x][y];
+
+			int idxUpper = 0;
+			for (unsigned i = 0; i < scheme.colors.size(); i++)
 			{
-				idxUpper = i;
-				break;
+				if (val < thresholds[i])
+				{
+					idxUpper = i;
+					break;
+				}
 			}
+
+			double min = thresholds[idxUpper - 1];
+			double range = thresholds[idxUpper] - min;
+
+			img[x][y] = RGBA::Interpolate(
+				scheme.colors[idxUpper - 1],
+				scheme.colors[idxUpper],
+				(val - min) / range
+			);
 		}
+	});
+}
 
-		double min = thresholds[idxUpper - 1];
-		double range = thresholds[idxUpper] - min;
+} // namespace
 
-		data[x][y] = RGBA::Interpolate(
-			scheme.colors[idxUpper - 1],
-			scheme.colors[idxUpper],
-			(val - min) / range
-		);
-	}
+Image::Image(const zmath::Map& m)
+	: Image(m.Bounds())
+{
+	fromMap(*this, m);
+}
+
+Image::Image(const zmath::Map& m, Scheme scheme)
+	: Image(m.Bounds())
+{
+	fromMap(*this, m, scheme);
+}
+
+Image::Image(const zmath::Mapf& m)
+	: Image(m.Bounds())
+{
+	fromMap(*this, m);
+}
+
+Image::Image(const zmath::Mapf& m, Scheme scheme)
+	: Image(m.Bounds())
+{
+	fromMap(*this, m, scheme);
 }
 
 Image::Image(std::string path)
 {
+	// stb expands grey, grey + alpha and RGB to RGBA itself
 	int width, height, channels = -1;
-	uint8* stbImg = stbi_load(path.c_str(), &width, &height, &channels, 0);
+	uint8* stbImg = stbi_load(path.c_str(), &width, &height, &channels, 4);
 
 	// Abort if it fails to load, or you'll crash the damn computer again
 	if (!stbImg || channels == -1) // I included the 'channels == -1' check bc I'm paranoid
 	{
-		std::cout << "[ERROR] Could not load image at " << path << "\n";
-
-		data = nullptr;
-		bounds = Vec();
-		return;
+		throw std::runtime_error("Could not load image at " + path);
 	}
 
-	bounds = Vec(width, height);
-
 	// Allocate data
-	data = alloc2d<RGBA>(width, height);
-
-	int stbIdx = 0;
-	LOOP_IMAGE_HORIZONTAL
-	{
-		switch (channels)
-		{
-		case 1: // Grayscale
-			data[x][y] = RGBA(stbImg[stbIdx]);
-			stbIdx++;
-			break;
-
-		case 2: // Grayscale with alpha
-			data[x][y] = RGBA(
-				stbImg[stbIdx],
-				stbImg[stbIdx + 1]);
-			stbIdx += 2;
-			break;
-
-		case 3: // RGB
-			data[x][y] = RGBA(
-				stbImg[stbIdx],
-				stbImg[stbIdx + 1],
-				stbImg[stbIdx + 2]);
-			stbIdx += 3;
-			break;
-
-		case 4: // RGBA
-			data[x][y] = RGBA(
-				stbImg[stbIdx],
-				stbImg[stbIdx + 1],
-				stbImg[stbIdx + 2],
-				stbImg[stbIdx + 3]);
-			stbIdx += 4;
-			break;
-		} // switch (channels)
-	}
+	AllocData(VecInt(width, height));
 
-	free(stbImg);
+	ParallelFor(0, bounds.X, [&](int begin, int end) {
+		forEachTile(VecInt(begin, 0), VecInt(end, bounds.Y), [&](int x, int y) {
+			std::memcpy(&(*this)[x][y], stbImg + ((size_t)y * width + x) * 4, 4);
+		});
+	}, bounds.Y);
 
-	std::cout << "Successfully loaded image at " << path << "\n"
-			    << " -> Channels:   " << channels << "\n"
-			    << " -> Dimensions: " << width << "x" << height << "\n";
+	stbi_image_free(stbImg);
 }
 
 Image::Image(const Image& img)
@@ -155,7 +189,7 @@ Image::Image()
 
 Image::~Image()
 {
-	free2d(data, bounds.X);
+	FreeData();
 }
 
 VecInt Image::Bounds() const
@@ -167,13 +201,10 @@ Image& Image::operator=(const Image& img)
 {
 	if (bounds != img.bounds)
 	{
-		free2d(data, bounds.X);
-		bounds = img.bounds;
-
-		data = alloc2d<RGBA>(bounds.X, bounds.Y, RGBA::Black());
+		AllocData(img.bounds, RGBA::Black());
 	}
 
-	LOOP_IMAGE data[x][y] = img[x][y];
+	ForEachLine(bounds, [&](int x) { std::copy(img[x], img[x] + bounds.Y, (*this)[x]); });
 	return *this;
 }
 
@@ -181,12 +212,14 @@ Image& Image::operator=(Image&& img)
 {
 	if (this != &img)
 	{
-		free2d(data, bounds.X);
+		FreeData();
 		bounds = img.bounds;
 		data = img.data;
+		stride = img.stride;
 
 		img.data = nullptr;
 		img.bounds = VecInt(0, 0);
+		img.stride = 0;
 	}
 
 	return *this;
@@ -202,7 +235,7 @@ std::unique_ptr<Image> Image::Copy(zmath::VecInt min_, zmath::VecInt max_) const
 	{
 		for (int y = min.Y; y < max.Y; y++)
 		{
-			img->data[x][y] = data[x - (int)min.X][y - (int)min.Y];
+			(*img)[x - min.X][y - min.Y] = (*this)[x][y];
 		}
 	}
 
@@ -218,7 +251,7 @@ Image& Image::Paste(const Image& img, zmath::VecInt at)
 			VecInt thisCoord = at + VecInt(x, y);
 			if (ContainsCoord(thisCoord))
 			{
-				data[thisCoord.X][thisCoord.Y] = img.data[x][y];
+				(*this)[thisCoord.X][thisCoord.Y] = img[x][y];
 			}
 		}
 	}
@@ -226,10 +259,10 @@ Image& Image::Paste(const Image& img, zmath::VecInt at)
 	return *this;
 }
 
-Image& zmath::Image::Tile(const Image& tile, VecInt tileSize, VecInt offset)
+Image& zmath::Image::Tile(const Image& tile, VecInt tileSize, VecInt offset, Filter filter)
 {
 	Image tileAdj = tile;
-	tileAdj.Resize(tileSize);
+	tileAdj.Resize(tileSize, filter);
 	VecInt tileBounds = tileAdj.Bounds();
 
 	// Bound offset within range of ( -tileBounds, {0, 0} ]
@@ -249,72 +282,122 @@ Image& zmath::Image::Tile(const Image& tile, VecInt tileSize, VecInt offset)
 	return *this;
 }
 
-Image& zmath::Image::Resize(VecInt to_bounds)
+Image& zmath::Image::Resize(VecInt to_bounds, Filter filter)
 {
 	Image img(to_bounds);
 
-	Vec scale =  Vec(bounds) / Vec(img.bounds);
-
-	for (int x = 0; x < img.bounds.X; x++)
+	// Nearest only picks pixels, so it copies them without going through doubles
+	if (filter == Filter::Nearest)
 	{
-		for (int y = 0; y < img.bounds.Y; y++)
-		{
-			VecInt samplePos = Vec(x, y) * scale;
+		const resample::Weights wx = resample::MakeWeights(filter, bounds.X, img.bounds.X);
+		const resample::Weights wy = resample::MakeWeights(filter, bounds.Y, img.bounds.Y);
 
-			img[x][y] = At(samplePos);
-		}
+		ForEachLine(img.bounds, [&](int x) {
+			const RGBA* line = (*this)[wx.first[x]];
+			for (int y = 0; y < img.bounds.Y; y++)
+			{
+				img[x][y] = line[wy.first[y]];
+			}
+		});
+
+		return *this = std::move(img);
 	}
 
+	std::vector<double> src((size_t)bounds.X * bounds.Y * 4);
+	std::vector<double> dst((size_t)img.bounds.X * img.bounds.Y * 4);
+
+	ForEachLine(bounds, [&](int x) {
+		double* line = &src[(size_t)x * bounds.Y * 4];
+		const RGBA* pixels = (*this)[x];
+		LOOP_LINE
+		{
+			line[4 * y] = pixels[y].R;
+			line[4 * y + 1] = pixels[y].G;
+			line[4 * y + 2] = pixels[y].B;
+			line[4 * y + 3] = pixels[y].A;
+		}
+	});
+
+	resample::Resample(filter, src.data(), bounds, bounds.Y * 4, dst.data(), img.bounds, img.bounds.Y * 4, 4);
 
-	return *this = img;
+	ForEachLine(img.bounds, [&](int x) {
+		const double* line = &dst[(size_t)x * img.bounds.Y * 4];
+		RGBA* pixels = img[x];
+		for (int y = 0; y < img.bounds.Y; y++)
+		{
+			pixels[y] = RGBA(toChannel(line[4 * y]), toChannel(line[4 * y + 1]),
+			                 toChannel(line[4 * y + 2]), toChannel(line[4 * y + 3]));
+		}
+	});
+
+	return *this = std::move(img);
 }
 
-Image& zmath::Image::Resize(double scaleFactor)
+Image& zmath::Image::Resize(double scaleFactor, Filter filter)
 {
-	return Resize(Vec(bounds) * scaleFactor);
+	return Resize(Vec(bounds) * scaleFactor, filter);
 }
 
 Image& zmath::Image::Clear(RGBA col)
 {
-	LOOP_IMAGE
-	{
-		data[x][y] = col;
-	}
+	ForEachLine(bounds, [&](int x) {
+		LOOP_LINE
+		{
+			(*this)[x][y] = col;
+		}
+	});
 
 	return *this;
 }
 
 Image& Image::Negative()
 {
-	LOOP_IMAGE data[x][y] = data[x][y].Negative();
+	ForEachLine(bounds, [&](int x) { LOOP_LINE (*this)[x][y] = (*this)[x][y].Negative(); });
 
 	return *this;
 }
 
+// Building the 6-bit cube costs a pass over the palette for each of its
+// 2^18 cells, so it only beats the tree for small palettes, and only when
+// there are many more pixels than entries to spread that over
+constexpr size_t PALETTE_CUBE_MAX_COLORS = 1024;
+constexpr long PALETTE_CUBE_PIXELS_PER_COLOR = 64;
+
 Image& Image::RestrictPalette(const std::vector<RGBA>& palette)
 {
-	assert(palette.size());
+	const bool cube = palette.size() <= PALETTE_CUBE_MAX_COLORS
+		&& (long)bounds.X * bounds.Y > PALETTE_CUBE_PIXELS_PER_COLOR * (long)palette.size();
+	return RestrictPalette(PaletteIndex(palette, cube ? 6 : 0));
+}
 
-	LOOP_IMAGE
-	{
-		int idx_min = -1;
-		double val_min = 500000; // higher than max distance between colors
+Image& Image::RestrictPalette(const PaletteIndex& index)
+{
+	const std::vector<RGBA>& palette = index.Palette();
 
-		for (unsigned i = 0; i < palette.size(); i++)
-		{
-			double min = RGBA::Distance(data[x][y], palette[i]);
+	ForEachLine(bounds, [&](int x) {
+		RGBA* line = (*this)[x];
+		LOOP_LINE line[y] = palette[index.Nearest(line[y])];
+	});
 
-			if (min < val_min)
-			{
-				idx_min = i;
-				val_min = min;
-			}
-		}
+	return *this;
+}
 
-		data[x][y] = palette.at(idx_min);
+MapT<uint8> Image::PaletteIndices(const PaletteIndex& index) const
+{
+	if (index.Palette().size() > 256)
+	{
+		throw std::runtime_error("Image: palette indices only fit in a uint8 for up to 256 colors!");
 	}
 
-	return *this;
+	MapT<uint8> indices(bounds);
+
+	ForEachLine(bounds, [&](int x) {
+		const RGBA* line = (*this)[x];
+		uint8* out = indices[x];
+		LOOP_LINE out[y] = (uint8)index.Nearest(line[y]);
+	});
+
+	return indices;
 }
 
 Image& Image::Fractalify(int octaves)
@@ -326,16 +409,8 @@ Image& Image::Fractalify(int octaves)
 
 	// Create a smaller version of this image
 	VecT<double> boxSize = bounds / gridRes;
-	Image img(boxSize);
-	for (int x = 0; x < img.bounds.X; x++)
-	{
-		for (int y = 0; y < img.bounds.Y; y++)
-		{
-			Vec coordHere = Vec(x, y) * gridRes;
-
-			img.At(x, y) = At(coordHere);
-		}
-	}
+	Image img(*this);
+	img.Resize(boxSize, Filter::Area);
 
 	// Copy that smaller image into this one, (2^octaves)^2 times
 	for (int x_box = 0; x_box < gridRes; x_box++)
@@ -362,77 +437,228 @@ Image& Image::Fractalify(int octaves)
 
 Image& zmath::Image::Droppify(std::array<Vec, 3> origins, std::array<double, 3> periods)
 {
-	LOOP_IMAGE
+	ForEachLine(bounds, [&](int x) {
+		LOOP_LINE
+		{
+			Vec pos(x, y);
+
+			// Calculate weights
+			std::array<double, 3> weights;
+			for (int i = 0; i < 3; i++)
+			{
+				weights[i] = std::sin(2.0 * PI * origins[i].DistForm(pos) / periods[i]);
+				weights[i] = (1.0 + weights[i]) / 2.0;
+			}
+
+			// Adjust intensity of weights
+			double intensity = DistForm<double, 3>(weights);
+			operator/=<double, 3>(weights, intensity);
+
+			// Apply weights
+			RGBA& pix = (*this)[x][y];
+			for (int i = 0; i < 3; i++)
+			{
+				pix[i] = (double)pix[i] * weights[i];
+			}
+		}
+	});
+
+	return *this;
+}
+
+namespace
+{
+
+// Above this sigma, BlurGaussian switches from a direct kernel to a
+// recursive filter, whose cost doesn't grow with sigma
+constexpr double RECURSIVE_BLUR_SIGMA = 5.0;
+
+// Rows are blurred a tile at a time, so that gathering them from the
+// x-lines reads whole cache lines
+constexpr int BLUR_ROW_TILE = 16;
+
+// A 1D Gaussian, applied along lines of interleaved 4-channel float pixels.
+// Pixels past the ends of a line are left out and the remaining weights
+// renormalized, which is what a 2D kernel clipped at the image edges does,
+// since a clipped 2D Gaussian is still the product of two clipped 1D ones.
+class GaussianLine
+{
+public:
+	// Prepares blurring lines of length 'n'
+	GaussianLine(double sigma, int n)
+		: n(n)
+		, recursive(sigma > RECURSIVE_BLUR_SIGMA)
+		, tail(0)
+		, inverseNorm(n)
+	{
+		if (recursive)
+		{
+			youngVanVliet(sigma);
+			tail = (int)std::ceil(4 * sigma);
+		}
+		else
+		{
+			const int radius = sigma * 2;
+			weights.resize(radius + 1);
+			for (int i = 0; i <= radius; i++)
+			{
+				weights[i] = std::exp(-0.5 * (i / sigma) * (i / sigma));
+			}
+		}
+
+		// Blurring a line of ones gives the weight that lands on each pixel
+		std::vector<float> ones(4 * n, 1.0f), sums(4 * n);
+		blur(ones.data(), sums.data(), false);
+		for (int i = 0; i < n; i++) inverseNorm[i] = 1.0f / sums[4 * i];
+	}
+
+	// Blurs the n pixels at 'in' into 'out', which may not overlap
+	void operator()(const float* in, float* out) const
+	{
+		blur(in, out, true);
+	}
+
+private:
+	int n;
+	bool recursive;
+	std::vector<float> weights;     // direct: weights[|offset|]
+	double b[4];                    // recursive: normalized feedback coefficients
+	double B;                       // recursive: input gain
+	int tail;                       // recursive: samples run past the end
+	std::vector<float> inverseNorm; // 1 / total weight reaching each pixel
+
+	// Coefficients from Young & van Vliet, "Recursive implementation of the
+	// Gaussian filter" (1995)
+	void youngVanVliet(double sigma)
 	{
-		Vec pos(x, y);
+		const double q = sigma >= 2.5
+			? 0.98711 * sigma - 0.96330
+			: 3.97156 - 4.14554 * std::sqrt(1.0 - 0.26891 * sigma);
+		const double q2 = q * q, q3 = q2 * q;
+
+		const double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+		b[1] = (2.44413 * q + 2.85619 * q2 + 1.26661 * q3) / b0;
+		b[2] = -(1.4281 * q2 + 1.26661 * q3) / b0;
+		b[3] = 0.422205 * q3 / b0;
+		B = 1.0 - (b[1] + b[2] + b[3]);
+	}
 
-		// Calculate weights
-		std::array<double, 3> weights;
-		for (int i = 0; i < 3; i++)
+	void blur(const float* in, float* out, bool normalize) const
+	{
+		if (recursive) blurRecursive(in, out);
+		else blurDirect(in, out);
+
+		if (normalize)
 		{
-			weights[i] = std::sin(2.0 * PI * origins[i].DistForm(pos) / periods[i]);
-			weights[i] = (1.0 + weights[i]) / 2.0;
+			for (int i = 0; i < n; i++)
+				for (int c = 0; c < 4; c++) out[4 * i + c] *= inverseNorm[i];
 		}
+	}
 
-		// Adjust intensity of weights
-		double intensity = DistForm<double, 3>(weights);
-		operator/=<double, 3>(weights, intensity);
+	void blurDirect(const float* in, float* out) const
+	{
+		const int radius = (int)weights.size() - 1;
+		for (int i = 0; i < n; i++)
+		{
+			const int lo = std::max(0, i - radius);
+			const int hi = std::min(n - 1, i + radius);
 
-		// Apply weights
-		RGBA& pix = data[x][y];
-		for (int i = 0; i < 3; i++)
+			float sum[4] = {};
+			for (int j = lo; j <= hi; j++)
+			{
+				const float w = weights[std::abs(j - i)];
+				for (int c = 0; c < 4; c++) sum[c] += w * in[4 * j + c];
+			}
+			for (int c = 0; c < 4; c++) out[4 * i + c] = sum[c];
+		}
+	}
+
+	// A causal pass then an anti-causal one. The causal pass runs on into the
+	// zeros past the end of the line, so that the anti-causal pass starts
+	// from the tail it would really see there rather than from zeros.
+	void blurRecursive(const float* in, float* out) const
+	{
+		std::vector<double> pass(n + tail);
+		for (int c = 0; c < 4; c++)
 		{
-			pix[i] = (double)pix[i] * weights[i];
+			double w1 = 0, w2 = 0, w3 = 0;
+			for (int i = 0; i < n + tail; i++)
+			{
+				const double w = (i < n ? B * in[4 * i + c] : 0) + b[1] * w1 + b[2] * w2 + b[3] * w3;
+				pass[i] = w;
+				w3 = w2; w2 = w1; w1 = w;
+			}
+
+			w1 = w2 = w3 = 0;
+			for (int i = n + tail - 1; i >= 0; i--)
+			{
+				const double w = B * pass[i] + b[1] * w1 + b[2] * w2 + b[3] * w3;
+				if (i < n) out[4 * i + c] = w;
+				w3 = w2; w2 = w1; w1 = w;
+			}
 		}
 	}
+};
 
-	return *this;
-}
+} // namespace
 
-// Blurs an image Gaussianly!
+// Blurs an image Gaussianly! The blur is separable, so it runs as a pass
+// along each x-line and then one along each y-row.
 Image& zmath::Image::BlurGaussian(double sigma, bool blurAlpha)
 {
-	int radius = sigma * 2;
-	GaussField gauss(sigma, 1.0, Vec());
-	const auto& points = gauss.Points(radius);
-	
-	Image imgNew(bounds);
+	if (bounds.X == 0 || bounds.Y == 0 || !(sigma > 0)) return *this;
 
-	LOOP_IMAGE
-	{
-		VecInt imgPos(x,y);
+	const GaussianLine blurY(sigma, bounds.Y);
+	const GaussianLine blurX(sigma, bounds.X);
+
+	// The image blurred along y, as floats, with each x-line contiguous
+	std::vector<float> blurred((size_t)bounds.X * bounds.Y * 4);
+
+	ForEachLine(bounds, [&](int x) {
+		std::vector<float> line(4 * bounds.Y);
+		LOOP_LINE
+		{
+			for (int c = 0; c < 4; c++) line[4 * y + c] = (*this)[x][y][c];
+		}
+		blurY(line.data(), &blurred[(size_t)x * bounds.Y * 4]);
+	});
 
-		double influence = 0;
-		std::array<double, 4> rgba;
-		for (const auto& point : points)
+	ParallelFor(0, bounds.Y, [&](int begin, int end) {
+		std::vector<float> rows(4 * bounds.X * BLUR_ROW_TILE);
+		std::vector<float> row(4 * bounds.X);
+
+		for (int tile = begin; tile < end; tile += BLUR_ROW_TILE)
 		{
-			const VecInt pointPos = point.first + imgPos;
+			const int count = std::min(BLUR_ROW_TILE, end - tile);
 
-			// If contains coord
-			if (pointPos >= VecInt() && pointPos < bounds)
+			// Gather the tile's rows
+			for (int x = 0; x < bounds.X; x++)
 			{
-				influence += point.second;
-				const RGBA& addCol = At(pointPos);
-				rgba[0] += point.second * addCol.R;
-				rgba[1] += point.second * addCol.G;
-				rgba[2] += point.second * addCol.B;
-				rgba[3] += point.second * addCol.A;
+				const float* src = &blurred[((size_t)x * bounds.Y + tile) * 4];
+				for (int r = 0; r < count; r++)
+					for (int c = 0; c < 4; c++) rows[(r * bounds.X + x) * 4 + c] = src[4 * r + c];
 			}
-		}
 
-		operator/=<double, 4>(rgba, influence);
+			for (int r = 0; r < count; r++)
+			{
+				const int y = tile + r;
+				blurX(&rows[r * bounds.X * 4], row.data());
 
-		imgNew[x][y] = RGBA((uint8)std::min(255.0, std::round(rgba[0])),
-							(uint8)std::min(255.0, std::round(rgba[1])),
-							(uint8)std::min(255.0, std::round(rgba[2])),
-							(blurAlpha) ? At(imgPos).A : (uint8)std::min(255.0, std::round(rgba[3])));
-	}
+				for (int x = 0; x < bounds.X; x++)
+				{
+					RGBA& pix = (*this)[x][y];
+					pix = RGBA(toChannel(row[4 * x]), toChannel(row[4 * x + 1]), toChannel(row[4 * x + 2]),
+					           blurAlpha ? toChannel(row[4 * x + 3]) : pix.A);
+				}
+			}
+		}
+	}, bounds.X * 4);
 
-	return *this = imgNew;
+	return *this;
 }
 
 // Warps an image Gaussianly-ish!
-Image& zmath::Image::PixelateGaussian(const Map& map, double sigma)
+Image& zmath::Image::PixelateGaussian(const Map& map, double sigma, const ProgressFn& progressFn)
 {
 	MapT<std::pair<Vec, double>> transforms(bounds);
 
@@ -440,46 +666,73 @@ Image& zmath::Image::PixelateGaussian(const Map& map, double sigma)
 	GaussField gauss(sigma, 1.0, Vec());
 	const auto points = gauss.Points(radius);
 
-	std::cout << "Performing Gaussian Warp on " << bounds << " Image:\n"
-		      << " -> sigma:  " << sigma << "\n"
-		      << " -> points: " << points.size() << "\n";
+	// The scatter and gather passes each count as one unit per x-line
+	Progress progress(progressFn, "PixelateGaussian", 2 * bounds.X);
 
-	LOOP_IMAGE
+	// Each pixel scatters into its neighbours, so this pass stays serial
+	for (int x = 0; x < bounds.X && !progress.Stopped(); x++)
 	{
-		VecInt imgPos(x, y);
-		
-		// Loop through gauss field points
-		for (const auto& point : points)
+		LOOP_LINE
 		{
-			// if map contains point and point's influence is larger than transform's current influence
-			VecInt pointPos = point.first + imgPos;
-			if (map.ContainsCoord(pointPos) && point.second*map[x][y] > transforms.At(pointPos).second)
+			VecInt imgPos(x, y);
+
+			// Loop through gauss field points
+			for (const auto& point : points)
 			{
-				transforms.At(pointPos) = { imgPos, point.second*map[x][y] };
-				//std::cout << "set " << point.first << " to " << imgPos << " " << point.second << "\n";
+				// if map contains point and point's influence is larger than transform's current influence
+				VecInt pointPos = point.first + imgPos;
+				if (map.ContainsCoord(pointPos) && point.second*map[x][y] > transforms.At(pointPos).second)
+				{
+					transforms.At(pointPos) = { imgPos, point.second*map[x][y] };
+					//std::cout << "set " << point.first << " to " << imgPos << " " << point.second << "\n";
+				}
 			}
 		}
-	}
 
-	std::cout << " -> Applying transforms . . .";
+		progress.Step();
+	}
 
 	Image imgNew(bounds);
-	LOOP_IMAGE
-	{
-		VecInt samplePos = transforms[x][y].first;
-		if (!map.ContainsCoord(samplePos))
+	ForEachLine(bounds, [&](int x) {
+		if (progress.Stopped()) return;
+
+		LOOP_LINE
 		{
-			samplePos = Vec::Max(VecInt(0, 0), Vec::Min(bounds - 1, samplePos));
+			VecInt samplePos = transforms[x][y].first;
+			if (!map.ContainsCoord(samplePos))
+			{
+				samplePos = Vec::Max(VecInt(0, 0), Vec::Min(bounds - 1, samplePos));
+			}
+			imgNew[x][y] = At(samplePos);
+			//std::cout << "setting " << Vec(x, y) << " to " << samplePos << "\n";
 		}
-		imgNew[x][y] = At(samplePos);
-		//std::cout << "setting " << Vec(x, y) << " to " << samplePos << "\n";
-	}
 
-	*this = imgNew;
+		progress.Step();
+	});
+	progress.Finish();
 
-	std::cout << " All done!\n";
+	return *this = imgNew;
+}
 
-	return *this;
+// Pushes each channel away from its value in 'blurred', a blurred copy
+static void enhanceAgainst(Image& img, const Image& blurred)
+{
+	const VecInt bounds = img.Bounds();
+	ForEachLine(bounds, [&](int x) {
+		LOOP_LINE
+		{
+			double dR = ((int)img[x][y].R - (int)blurred[x][y].R) / 255.0;
+			double dG = ((int)img[x][y].G - (int)blurred[x][y].G) / 255.0;
+			double dB = ((int)img[x][y].B - (int)blurred[x][y].B) / 255.0;
+
+			if (dR < 0) img[x][y].R *= (1.0 + dR);
+			else img[x][y].R += dR * (255.0 - img[x][y].R);
+			if (dG < 0) img[x][y].G *= (1.0 + dG);
+			else img[x][y].G += dG * (255.0 - img[x][y].G);
+			if (dB < 0) img[x][y].B *= (1.0 + dB);
+			else img[x][y].B += dB * (255.0 - img[x][y].B);
+		}
+	});
 }
 
 Image& zmath::Image::EnhanceContrast(double sigma)
@@ -487,19 +740,36 @@ Image& zmath::Image::EnhanceContrast(double sigma)
 	Image blurred(*this);
 	blurred.BlurGaussian(sigma);
 
-	LOOP_IMAGE
-	{
-		double dR = ((int)data[x][y].R - (int)blurred[x][y].R) / 255.0;
-		double dG = ((int)data[x][y].G - (int)blurred[x][y].G) / 255.0;
-		double dB = ((int)data[x][y].B - (int)blurred[x][y].B) / 255.0;
-
-		if (dR < 0) data[x][y].R *= (1.0 + dR);
-		else data[x][y].R += dR * (255.0 - data[x][y].R);
-		if (dG < 0) data[x][y].G *= (1.0 + dG);
-		else data[x][y].G += dG * (255.0 - data[x][y].G);
-		if (dB < 0) data[x][y].B *= (1.0 + dB);
-		else data[x][y].B += dB * (255.0 - data[x][y].B);
-	}
+	enhanceAgainst(*this, blurred);
+
+	return *this;
+}
+
+Image& zmath::Image::BoxBlur(int radius, bool blurAlpha)
+{
+	const SummedArea area(*this, false);
+
+	ForEachLine(bounds, [&](int x) {
+		LOOP_LINE
+		{
+			const Rect window = SummedArea::Window(VecInt(x, y), radius);
+			RGBA& pix = (*this)[x][y];
+			for (int c = 0; c < (blurAlpha ? 4 : 3); c++)
+			{
+				pix[c] = toChannel(area.Mean(window, c));
+			}
+		}
+	});
+
+	return *this;
+}
+
+Image& zmath::Image::EnhanceContrastBox(int radius)
+{
+	Image blurred(*this);
+	blurred.BoxBlur(radius);
+
+	enhanceAgainst(*this, blurred);
 
 	return *this;
 }
@@ -511,25 +781,26 @@ void Image::Save(std::string path, unsigned int channels) const
 		throw std::runtime_error("Image: I only know how to save 3- and 4-channel images!");
 	}
 
-	uint8* pixels = new uint8[(uint64_t)bounds.X * (uint64_t)bounds.Y * channels];
+	// Repack the x-lines into the row-major buffer stb writes from
+	std::vector<uint8> pixels((size_t)bounds.X * bounds.Y * channels);
 
-	int index = 0;
-	for (int y = 0; y < bounds.Y; y++)
-	{
-		for (int x = 0; x < bounds.X; x++)
+	ParallelFor(0, bounds.Y, [&](int begin, int end) {
+		// Constant sizes let each copy compile to a plain move
+		if (channels == 4)
 		{
-			RGBA col = data[x][y];
-
-			pixels[index++] = col.R;
-			pixels[index++] = col.G;
-			pixels[index++] = col.B;
-			if (channels == 4) pixels[index++] = col.A;
+			forEachTile(VecInt(0, begin), VecInt(bounds.X, end), [&](int x, int y) {
+				std::memcpy(&pixels[((size_t)y * bounds.X + x) * 4], &(*this)[x][y], 4);
+			});
 		}
-	}
-
-	stbi_write_png(path.c_str(), bounds.X, bounds.Y, channels, pixels, bounds.X * channels);
+		else
+		{
+			forEachTile(VecInt(0, begin), VecInt(bounds.X, end), [&](int x, int y) {
+				std::memcpy(&pixels[((size_t)y * bounds.X + x) * 3], &(*this)[x][y], 3);
+			});
+		}
+	}, bounds.X);
 
-	delete[] pixels;
+	stbi_write_png(path.c_str(), bounds.X, bounds.Y, channels, pixels.data(), bounds.X * channels);
 }
 
 void zmath::Image::SaveMNIST(std::string path_images, std::string path_labels, int columns, int emptyBorderSize) const
@@ -547,7 +818,7 @@ void zmath::Image::SaveMNIST(std::string path_images, std::string path_labels, i
 	}
 	Image copy(*this);
 	//copy.BlurGaussian(1.0, false);
-	copy.Resize(minBounds);
+	copy.Resize(minBounds, Filter::Area);
 
 	// Open files, check if ok, and write empty headers
 	std::ofstream fout_images(path_images, std::ios_base::binary);
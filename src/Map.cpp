@@ -1,12 +1,19 @@
 #include <zarks/math/Map.h>
+#include <zarks/math/SummedArea.h>
 #include <zarks/internal/zmath_internals.h>
+#include <zarks/internal/simd.h>
+#include <zarks/internal/parallel.h>
+#include <zarks/internal/resample.h>
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
-#include <iostream>
 #include <exception>
 
 #define LOOP_MAP for (int x = 0; x < bounds.X; x++) for (int y = 0; y < bounds.Y; y++)
+// Loops over one x-line of the map. Per-pixel work goes through ForEachLine so
+// that lines are spread over threads according to the execution policy.
+#define LOOP_LINE for (int y = 0; y < bounds.Y; y++)
 #define BOUNDABORT( m ) if (bounds != m.bounds) throw std::runtime_error("Map bounds don't match!")
 
 namespace zmath
@@ -35,6 +42,7 @@ Map::Map(const Map& map)
 
 Map::Map(Map&& map)
 	: Sampleable2D()
+	, subMap(false)
 {
 	*this = std::move(map);
 }
@@ -48,15 +56,11 @@ Map& Map::operator=(const Map& rhs)
 {
 	if (bounds != rhs.bounds)
 	{
-		FreeData();
-
-		bounds = rhs.bounds;
+		AllocData(rhs.bounds);
 		subMap = false;
-
-		data = alloc2d<double>(bounds.X, bounds.Y);
 	}
 
-	LOOP_MAP data[x][y] = rhs.data[x][y];
+	ForEachLine(bounds, [&](int x) { std::copy(rhs[x], rhs[x] + bounds.Y, line(x)); });
 	return *this;
 }
 
@@ -68,11 +72,19 @@ Map& Map::operator=(Map&& rhs)
 
 		data = rhs.data;
 		bounds = rhs.bounds;
+		stride = rhs.stride;
 		subMap = rhs.subMap;
 
 		rhs.data = nullptr;
 		rhs.bounds = VecInt(0, 0);
+		rhs.stride = 0;
 		rhs.subMap = false;
+
+		// Caching state stays with the data it describes
+		shared = rhs.shared.load();
+		rhs.shared = false;
+		rhs.invalidate();
+		invalidate();
 	}
 
 	return *this;
@@ -80,11 +92,14 @@ Map& Map::operator=(Map&& rhs)
 
 void Map::FreeData()
 {
+	invalidate();
+
 	if (subMap)
 	{
-		delete data;
+		// Submaps only view their parent's data, so there is nothing to free
 		data = nullptr;
 		bounds = VecInt(0, 0);
+		stride = 0;
 	}
 	else
 	{
@@ -92,36 +107,78 @@ void Map::FreeData()
 	}
 }
 
-double Map::GetMin() const
-{
-	double min = data[0][0];
+MapStats Map::Stats() const
+{
+	// A hit needs no lock: the cache is written before statsValid is set
+	if (statsValid.load(std::memory_order_acquire)) return stats;
+
+	std::lock_guard<std::mutex> lock(statsMutex);
+	if (statsValid.load(std::memory_order_relaxed)) return stats;
+
+	MapStats result = {};
+	if (bounds.Area() == 0) return result;
+
+	// Per-line count, mean and sum of squared deviations (M2), merged with
+	// Chan et al.'s pairwise update. Each line is read twice, but only
+	// while it is still in cache, which keeps the line pass vectorized and
+	// avoids the cancellation of the naive sum-of-squares formula.
+	struct Partial {
+		double count, min, max, sum, mean, m2;
+	};
+
+	const double first = (*this)[0][0];
+	const Partial total = ReduceLines(bounds, Partial{ 0, first, first, 0, 0, 0 },
+		[&](int x) {
+			Partial p;
+			p.count = bounds.Y;
+			simd::MinMaxSum((*this)[x], bounds.Y, p.min, p.max, p.sum);
+			p.mean = p.sum / p.count;
+			p.m2 = simd::SumSquaredDiff((*this)[x], bounds.Y, p.mean);
+			return p;
+		},
+		[](const Partial& a, const Partial& b) {
+			Partial ab;
+			ab.count = a.count + b.count;
+			ab.min = std::min(a.min, b.min);
+			ab.max = std::max(a.max, b.max);
+			ab.sum = a.sum + b.sum;
+
+			const double delta = b.mean - a.mean;
+			ab.mean = a.mean + delta * b.count / ab.count;
+			ab.m2 = a.m2 + b.m2 + delta * delta * a.count * b.count / ab.count;
+			return ab;
+		});
+
+	result.min = total.min;
+	result.max = total.max;
+	result.sum = total.sum;
+	result.mean = total.sum / total.count;
+	result.variance = total.m2 / (total.count - 1);
+	result.stdDev = std::sqrt(result.variance);
+
+	if (!subMap && !shared)
+	{
+		stats = result;
+		statsValid.store(true, std::memory_order_release);
+	}
 
-	LOOP_MAP min = std::min(min, data[x][y]);
+	return result;
+}
 
-	return min;
+double Map::GetMin() const
+{
+	return Stats().min;
 }
 
 double Map::GetMax() const
 {
-	double max = data[0][0];
-
-	LOOP_MAP max = std::max(max, data[x][y]);
-
-	return max;
+	return Stats().max;
 }
 
 std::pair<double, double> Map::GetMinMax() const
 {
-	std::pair<double, double> minmax;
-
-	// I'm the only one who has to read this code I'm the only one who has to read this code I'm the only one who has to read this code I'm the only 
-	LOOP_MAP
-	{
-		minmax.first = std::min(minmax.first, data[x][y]);
-		minmax.second = std::max(minmax.second, data[x][y]);
-	}
-
-	return minmax;
+	const MapStats s = Stats();
+	return std::make_pair(s.min, s.max);
 }
 
 VecInt Map::Bounds() const
@@ -131,29 +188,22 @@ VecInt Map::Bounds() const
 
 double Map::Sum() const
 {
-	double sum = 0;
-	LOOP_MAP sum += data[x][y];
-	return sum;
+	return Stats().sum;
 }
 
 double Map::Mean() const
 {
-	return Sum() / (double)bounds.Area();
+	return Stats().mean;
 }
 
 double Map::Variance() const
 {
-	double mean = Mean();
-	double variance = 0;
-
-	LOOP_MAP variance += std::pow(mean - data[x][y], 2);
-
-	return variance / (double)(bounds.Area() - 1);
+	return Stats().variance;
 }
 
 double Map::Std() const
 {
-	return std::sqrt(Variance());
+	return Stats().stdDev;
 }
 
 Vec Map::DerivativeAt(VecInt pos) const
@@ -239,46 +289,61 @@ Map Map::operator()(VecInt min_, VecInt max_) const
 	min = VecInt::Max(min, VecInt(0, 0));
 	max = VecInt::Min(max, bounds);
 
-	// Initialize submap
+	// Initialize submap. Writes through it bypass this map's stats cache.
 	Map m;
 	m.subMap = true;
+	shared = true;
+	invalidate();
 
-	// Make the new map's data a subset of the called map's data
-	m.data = new double* [max.X - min.X];
-	for (int idx = 0, x = min.X; x < max.X; x++, idx++)
-	{
-		m.data[idx] = &(data[x][min.Y]);
-	}
+	// Make the new map's data a window into the called map's data. Sharing
+	// the parent's stride is all it takes to skip over the excluded region.
+	m.data = data + (size_t)min.X * stride + min.Y;
+	m.bounds = max - min;
+	m.stride = stride;
 
 	return m;
 }
 
+Map& Map::Resize(VecInt to_bounds, Filter filter)
+{
+	Map m(to_bounds);
+	resample::Resample(filter, data, bounds, stride, m.data, m.bounds, m.stride, 1);
+	return *this = std::move(m);
+}
+
+Map& Map::Resize(double scaleFactor, Filter filter)
+{
+	return Resize(Vec(bounds) * scaleFactor, filter);
+}
+
 Map& Map::Clear(double val)
 {
-	LOOP_MAP data[x][y] = val;
+	ForEachLine(bounds, [&](int x) { simd::Fill(line(x), bounds.Y, val); });
 	return *this;
 }
 
 Map& Map::Interpolate(double newMin, double newMax)
 {
-	auto old = GetMinMax();
+	const auto old = GetMinMax();
 	double oldRange = old.second - old.first;
 	if (oldRange == 0)
 	{
-		LOOP_MAP data[x][y] = newMin;
-		return *this;
+		return Clear(newMin);
 	}
 
 	double newRange = newMax - newMin;
 
-	LOOP_MAP data[x][y] = (data[x][y] - old.first) / oldRange * newRange + newMin;
+	ForEachLine(bounds, [&](int x) {
+		double* row = line(x);
+		LOOP_LINE row[y] = (row[y] - old.first) / oldRange * newRange + newMin;
+	});
 
 	return *this;
 }
 
 Map& Map::Abs()
 {
-	LOOP_MAP data[x][y] = std::abs(data[x][y]);
+	ForEachLine(bounds, [&](int x) { simd::Abs(line(x), bounds.Y); });
 	return *this;
 }
 
@@ -300,9 +365,10 @@ Map& Map::Fill(VecInt min, VecInt max, double val)
 {
 	for (int x = min.X; x < max.X; x++)
 	{
+		double* row = line(x);
 		for (int y = min.Y; y < max.Y; y++)
 		{
-			data[x][y] = val;
+			row[y] = val;
 		}
 	}
 	return *this;
@@ -310,19 +376,51 @@ Map& Map::Fill(VecInt min, VecInt max, double val)
 
 Map& Map::Replace(double val, double with)
 {
-	LOOP_MAP if (data[x][y] == val) data[x][y] = with;
+	ForEachLine(bounds, [&](int x) { simd::Replace(line(x), bounds.Y, val, with); });
 	return *this;
 }
 
 Map& Map::Apply(const GaussField& gauss)
 {
-	LOOP_MAP data[x][y] += gauss.Sample(x, y);
+	ForEachLine(bounds, [&](int x) {
+		double* row = line(x);
+		LOOP_LINE row[y] += gauss.Sample(x, y);
+	});
 	return *this;
 }
 
+// Under Exec::Parallel, 'calculation' is called from several threads at once
 Map& Map::Apply(double(*calculation)(double))
 {
-	LOOP_MAP data[x][y] = calculation(data[x][y]);
+	ForEachLine(bounds, [&](int x) {
+		double* row = line(x);
+		LOOP_LINE row[y] = calculation(row[y]);
+	});
+	return *this;
+}
+
+Map& Map::BoxBlur(int radius)
+{
+	const SummedArea area(*this, false);
+	ForEachLine(bounds, [&](int x) {
+		double* row = line(x);
+		LOOP_LINE row[y] = area.Mean(SummedArea::Window(VecInt(x, y), radius));
+	});
+	return *this;
+}
+
+Map& Map::LocalContrast(int radius, double epsilon)
+{
+	const SummedArea area(*this);
+	ForEachLine(bounds, [&](int x) {
+		double* row = line(x);
+		LOOP_LINE
+		{
+			const Rect window = SummedArea::Window(VecInt(x, y), radius);
+			const double std = std::sqrt(area.Variance(window));
+			row[y] = (row[y] - area.Mean(window)) / (std + epsilon);
+		}
+	});
 	return *this;
 }
 
@@ -330,26 +428,29 @@ Map Map::SlopeMap()
 {
 	Map m(bounds);
 
-	LOOP_MAP m.At(x, y) = SlopeAt(VecInt(x, y));
+	ForEachLine(bounds, [&](int x) {
+		double* row = m.line(x);
+		LOOP_LINE row[y] = SlopeAt(VecInt(x, y));
+	});
 
 	return m;
 }
 
 Map& Map::BoundMax(double newMax)
 {
-	LOOP_MAP data[x][y] = std::min(newMax, data[x][y]);
+	ForEachLine(bounds, [&](int x) { simd::Min(line(x), bounds.Y, newMax); });
 	return *this;
 }
 
 Map& Map::BoundMin(double newMin)
 {
-	LOOP_MAP data[x][y] = std::max(newMin, data[x][y]);
+	ForEachLine(bounds, [&](int x) { simd::Max(line(x), bounds.Y, newMin); });
 	return *this;
 }
 
 Map& Map::Bound(double newMin, double newMax)
 {
-	LOOP_MAP data[x][y] = std::min(newMax, std::max(newMin, data[x][y]));
+	ForEachLine(bounds, [&](int x) { simd::Clamp(line(x), bounds.Y, newMin, newMax); });
 	return *this;
 }
 
@@ -357,8 +458,8 @@ Map& Map::operator+=(const Map& m)
 {
 	BOUNDABORT(m);
 
-	LOOP_MAP data[x][y] += m.data[x][y];
-		
+	ForEachLine(bounds, [&](int x) { simd::Add(line(x), m[x], bounds.Y); });
+
 	return *this;
 }
 
@@ -366,7 +467,7 @@ Map& Map::operator-=(const Map& m)
 {
 	BOUNDABORT(m);
 
-	LOOP_MAP data[x][y] -= m.data[x][y];
+	ForEachLine(bounds, [&](int x) { simd::Sub(line(x), m[x], bounds.Y); });
 
 	return *this;
 }
@@ -375,7 +476,7 @@ Map& Map::operator*=(const Map& m)
 {
 	BOUNDABORT(m);
 
-	LOOP_MAP data[x][y] *= m.data[x][y];
+	ForEachLine(bounds, [&](int x) { simd::Mul(line(x), m[x], bounds.Y); });
 
 	return *this;
 }
@@ -384,43 +485,32 @@ Map& Map::operator/=(const Map& m)
 {
 	BOUNDABORT(m);
 
-	LOOP_MAP
-	{
-		if (m.data[x][y] == 0)
-		{
-			if (data[x][y] > 0) data[x][y] = DOUBLEMAX;
-			else if (data[x][y] < 0) data[x][y] = DOUBLEMIN;
-		}
-		else
-		{
-			data[x][y] /= m.data[x][y];
-		}
-	}
+	ForEachLine(bounds, [&](int x) { simd::Div(line(x), m[x], bounds.Y); });
 
 	return *this;
 }
 
 Map& Map::operator+=(double val)
 {
-	LOOP_MAP data[x][y] += val;
+	ForEachLine(bounds, [&](int x) { simd::Add(line(x), bounds.Y, val); });
 	return *this;
 }
 
 Map& Map::operator-=(double val)
 {
-	LOOP_MAP data[x][y] -= val;
+	ForEachLine(bounds, [&](int x) { simd::Sub(line(x), bounds.Y, val); });
 	return *this;
 }
 
 Map& Map::operator*=(double val)
 {
-	LOOP_MAP data[x][y] *= val;
+	ForEachLine(bounds, [&](int x) { simd::Mul(line(x), bounds.Y, val); });
 	return *this;
 }
 
 Map& Map::operator/=(double val)
 {
-	if (val != 0) LOOP_MAP data[x][y] /= val;
+	if (val != 0) ForEachLine(bounds, [&](int x) { simd::Div(line(x), bounds.Y, val); });
 	return *this;
 }
 
@@ -436,7 +526,7 @@ Map& Map::Div(double val) { return *this /= val; }
 
 Map& Map::Pow(double exp)
 {
-	LOOP_MAP data[x][y] = std::pow(data[x][y], exp);
+	ForEachLine(bounds, [&](int x) { simd::Pow(line(x), bounds.Y, exp); });
 	return *this;
 }
 
@@ -472,7 +562,7 @@ void Map::Save(std::string path)
 	// Write the actual map data, little-endian
 	LOOP_MAP
 	{
-		double valDouble = data[x][y];
+		double valDouble = static_cast<const Map&>(*this)[x][y];
 		uint64_t val = *reinterpret_cast<uint64_t*>(&valDouble);
 
 		uint8_t arr[8];
@@ -487,8 +577,6 @@ void Map::Save(std::string path)
 
 		file.write((char*)arr, sizeof(arr));
 	}
-		
-	std::cout << "File saved at " << path << "\n";
 }
 
 } // namespace zmath
@@ -7,48 +7,40 @@
 namespace zmath
 {
 
+// Evenly spaced directions around the unit circle
+const std::array<Vec, NoiseHash::GRADIENTS> NoiseHash::gradients = [] {
+    std::array<Vec, GRADIENTS> table;
+    for (int i = 0; i < GRADIENTS; i++)
+    {
+        table[i] = Vec::UnitVector(2.0 * PI * i / GRADIENTS);
+    }
+    return table;
+}();
+
 NoiseHash::NoiseHash(uint64_t seed)
-    : eng(seed == RANDOM_SEED ? std::chrono::system_clock::now().time_since_epoch().count() : seed)
-    , angleRNG(0, 2.0*PI)
+    : seed(seed == RANDOM_SEED ? std::chrono::system_clock::now().time_since_epoch().count() : seed)
+    , seedKey(mix64(this->seed))
+    , octave(0)
 {}
 
-bool NoiseHash::Exists(VecInt key) const
-{
-    return hash.count(key) == 1;
-}
-
-Vec& NoiseHash::Create(VecInt key, Vec val)
-{
-    hash.emplace(key, val);
-    return hash.at(key);
-}
-
-Vec& NoiseHash::Create(VecInt key)
-{
-    return Create(key, Vec::UnitVector(angleRNG(eng)));
-}
-
 void NoiseHash::Clear()
 {
-    hash.clear();
+    octave++;
 }
 
-Vec& NoiseHash::operator[](VecInt key)
+int NoiseHash::Octave() const
 {
-    if (Exists(key))
-        return hash.at(key);
-    else
-        return Create(key);
+    return octave;
 }
 
-Vec& NoiseHash::At(VecInt key)
+void NoiseHash::SetOctave(int octave)
 {
-    return hash.at(key);
+    this->octave = octave;
 }
 
-const Vec& NoiseHash::At(VecInt key) const
+uint64_t NoiseHash::Seed() const
 {
-    return hash.at(key);
+    return seed;
 }
 
 } // namespace zmath
@@ -1,4 +1,11 @@
 #include <zarks/noise/Noiser.h>
+#include <zarks/internal/parallel.h>
+#include <zarks/internal/simd_target.h>
+#include <zarks/internal/noise_points.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 namespace zmath
 {
@@ -7,25 +14,52 @@ namespace zmath
 // Noiser Class //
 //              //
 
-Noiser::Noiser(double (*noiseFunc)(Vec, NoiseHash&), uint64_t seed)
+Noiser::Noiser(NoisePointFunc noiseFunc, uint64_t seed)
     : hash(seed)
     , noiseFunc(noiseFunc)
+    , batchFunc(nullptr)
+{
+    // The built-in functions have batched versions that do the same thing faster
+    if (noiseFunc == SimplexPoint) batchFunc = SimplexPoints;
+    if (noiseFunc == PerlinPoint) batchFunc = PerlinPoints;
+}
+
+Noiser::Noiser(NoiseBatchFunc batchFunc, uint64_t seed)
+    : hash(seed)
+    , noiseFunc(nullptr)
+    , batchFunc(batchFunc)
 {}
 
-Map Noiser::operator()(VecInt dimensions, int octaves, bool interpolate)
+Map Noiser::operator()(VecInt dimensions, int octaves, bool interpolate, const ProgressFn& progressFn)
 {
-    std::cout << "Generating new Noiser map:\n"
-              << " -> Width:  " << dimensions.X << "\n"
-              << " -> Height: " << dimensions.Y << "\n";
+    Progress progress(progressFn, "Noiser", dimensions.X);
 
     Map map(dimensions);
 
+    // The gradients of each octave, as successive AddOctave calls would see them
+    std::vector<NoiseHash> hashes;
     for (int oct = 0; oct < octaves; oct++)
     {
-        AddOctave(map, oct);
-        std::cout << " -> Octave \033[1;32m" << oct + 1 << "\033[0m Finished.\r" << std::flush;
+        hash.Clear();
+        hashes.push_back(hash);
     }
-    std::cout << " -> All done!                       \n";
+
+    // Run every octave over a line before moving on to the next one, so the
+    // line is accumulated while it is still in cache
+    ParallelFor(0, dimensions.X, [&](int begin, int end) {
+        LineBuffers buffers;
+        for (int x = begin; x < end && !progress.Stopped(); x++)
+        {
+            double* line = writeLine(map, x);
+            for (int oct = 0; oct < octaves; oct++)
+            {
+                addLine(line, x, dimensions, oct, hashes[oct], buffers);
+            }
+
+            progress.Step();
+        }
+    }, dimensions.Y);
+    progress.Finish();
 
     if (interpolate)
     {
@@ -39,19 +73,40 @@ void Noiser::AddOctave(Map& map, int octave)
 {
     hash.Clear();
 
+    const VecInt dim = map.Bounds();
+    ParallelFor(0, dim.X, [&](int begin, int end) {
+        LineBuffers buffers;
+        for (int x = begin; x < end; x++) addLine(writeLine(map, x), x, dim, octave, hash, buffers);
+    }, dim.Y);
+}
+
+// Under Exec::Parallel, this runs for several lines at once, each band of
+// lines with its own 'buffers'
+void Noiser::addLine(double* line, int x, VecInt dim, int octave, NoiseHash octaveHash, LineBuffers& buffers) const
+{
     const double octPow = std::pow(2, octave);
     const double octInfluence = 1.0 / octPow;
-
-    const VecInt dim = map.Bounds();
     const Vec scale = Vec(octPow, octPow) / Vec(dim);
 
-    for (int x = 0; x < dim.X; x++)
+    if (batchFunc)
     {
-        for (int y = 0; y < dim.Y; y++)
-        {
-            const Vec point = Vec(x, y) * scale;
-            map[x][y] += octInfluence * noiseFunc(point, hash);
-        }
+        std::vector<double>& xs = buffers.xs;
+        std::vector<double>& ys = buffers.ys;
+        std::vector<double>& out = buffers.out;
+        xs.assign(dim.Y, x * scale.X);
+        ys.resize(dim.Y);
+        out.resize(dim.Y);
+        for (int y = 0; y < dim.Y; y++) ys[y] = y * scale.Y;
+
+        batchFunc(xs.data(), ys.data(), out.data(), dim.Y, octaveHash);
+        for (int y = 0; y < dim.Y; y++) line[y] += octInfluence * out[y];
+        return;
+    }
+
+    for (int y = 0; y < dim.Y; y++)
+    {
+        const Vec point = Vec(x, y) * scale;
+        line[y] += octInfluence * noiseFunc(point, octaveHash);
     }
 }
 
@@ -59,44 +114,278 @@ void Noiser::AddOctave(Map& map, int octave)
 // Example Functions //
 //                   //
 
-double SimplexPoint(Vec coord, NoiseHash& hash)
+// The batched functions below are spelled out once per instruction set. Each
+// path performs the same operations in the same order, so all of them, and
+// the single-point functions, agree exactly.
+
+namespace
 {
-    Vec skewed = simplex::skew(coord);
-    Vec itl = skewed - skewed.Floor();
-    // Corners of this simplex
-    VecInt corners[3];
-    corners[0] = skewed.Floor();
-    corners[1] = corners[0] + ((itl.X > itl.Y) ? VecInt(1, 0) : VecInt(0, 1));
-    corners[2] = corners[0] + VecInt(1, 1);
-
-    double Z = 0;
-    for (int i = 0; i < 3; i++)
+    using points::SIMPLEX_R2;
+    using points::simplexPoint;
+    using points::perlinPoint;
+
+#ifdef ZMATH_SIMD_X86
+    // Looks up the gradients of 'lanes' lattice points, given as doubles
+    inline void gatherGradients(const NoiseHash& hash, const double* cx, const double* cy, double* gx, double* gy, int lanes)
     {
-        Vec displacement = coord - simplex::unskew(corners[i]);
-        double distance = displacement.DistForm();
-        double influence = std::pow(std::max(0.0, 0.625 - distance * distance), 4.0);
-        Z += influence * displacement.Dot(hash[corners[i]]);
+        for (int j = 0; j < lanes; j++)
+        {
+            const Vec g = hash[VecInt((int)cx[j], (int)cy[j])];
+            gx[j] = g.X;
+            gy[j] = g.Y;
+        }
     }
 
-    return Z;
+    //      //
+    // SSE2 //
+    //      //
+
+    namespace sse2
+    {
+        // std::floor for values within the range of an int
+        inline __m128d floor(__m128d v)
+        {
+            const __m128d t = _mm_cvtepi32_pd(_mm_cvttpd_epi32(v));
+            return _mm_sub_pd(t, _mm_and_pd(_mm_cmpgt_pd(t, v), _mm_set1_pd(1.0)));
+        }
+
+        inline __m128d fade(__m128d t)
+        {
+            const __m128d inner = _mm_add_pd(_mm_mul_pd(t, _mm_sub_pd(_mm_mul_pd(t, _mm_set1_pd(6.0)), _mm_set1_pd(15.0))), _mm_set1_pd(10.0));
+            return _mm_mul_pd(_mm_mul_pd(_mm_mul_pd(t, t), t), inner);
+        }
+
+        inline __m128d lerp(__m128d a, __m128d b, __m128d t)
+        {
+            return _mm_add_pd(_mm_mul_pd(t, b), _mm_mul_pd(_mm_sub_pd(_mm_set1_pd(1.0), t), a));
+        }
+
+        inline __m128d simplexCorner(__m128d x, __m128d y, __m128d cx, __m128d cy, const NoiseHash& hash)
+        {
+            alignas(16) double cxs[2], cys[2], gxs[2], gys[2];
+            _mm_store_pd(cxs, cx);
+            _mm_store_pd(cys, cy);
+            gatherGradients(hash, cxs, cys, gxs, gys, 2);
+
+            const __m128d t = _mm_mul_pd(_mm_add_pd(cx, cy), _mm_set1_pd(simplex::G2D));
+            const __m128d dx = _mm_sub_pd(x, _mm_sub_pd(cx, t));
+            const __m128d dy = _mm_sub_pd(y, _mm_sub_pd(cy, t));
+
+            const __m128d d2 = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+            const __m128d f = _mm_max_pd(_mm_sub_pd(_mm_set1_pd(SIMPLEX_R2), d2), _mm_setzero_pd());
+            const __m128d f2 = _mm_mul_pd(f, f);
+            const __m128d dot = _mm_add_pd(_mm_mul_pd(dx, _mm_load_pd(gxs)), _mm_mul_pd(dy, _mm_load_pd(gys)));
+            return _mm_mul_pd(_mm_mul_pd(f2, f2), dot);
+        }
+
+        void SimplexPoints(const double* xs, const double* ys, double* out, size_t n, const NoiseHash& hash)
+        {
+            const __m128d one = _mm_set1_pd(1.0);
+
+            size_t i = 0;
+            for (; i + 2 <= n; i += 2)
+            {
+                const __m128d x = _mm_loadu_pd(xs + i);
+                const __m128d y = _mm_loadu_pd(ys + i);
+                const __m128d s = _mm_mul_pd(_mm_add_pd(x, y), _mm_set1_pd(simplex::F2D));
+                const __m128d sx = _mm_add_pd(x, s);
+                const __m128d sy = _mm_add_pd(y, s);
+                const __m128d bx = floor(sx);
+                const __m128d by = floor(sy);
+                const __m128d lower = _mm_cmpgt_pd(_mm_sub_pd(sx, bx), _mm_sub_pd(sy, by));
+
+                __m128d Z = _mm_setzero_pd();
+                Z = _mm_add_pd(Z, simplexCorner(x, y, bx, by, hash));
+                Z = _mm_add_pd(Z, simplexCorner(x, y,
+                    _mm_add_pd(bx, _mm_and_pd(lower, one)),
+                    _mm_add_pd(by, _mm_andnot_pd(lower, one)), hash));
+                Z = _mm_add_pd(Z, simplexCorner(x, y, _mm_add_pd(bx, one), _mm_add_pd(by, one), hash));
+                _mm_storeu_pd(out + i, Z);
+            }
+
+            for (; i < n; i++) out[i] = simplexPoint(xs[i], ys[i], hash);
+        }
+
+        void PerlinPoints(const double* xs, const double* ys, double* out, size_t n, const NoiseHash& hash)
+        {
+            const __m128d one = _mm_set1_pd(1.0);
+            alignas(16) double bxs[2], bys[2], bxs1[2], bys1[2];
+            alignas(16) double gx[4][2], gy[4][2];
+
+            size_t i = 0;
+            for (; i + 2 <= n; i += 2)
+            {
+                const __m128d x = _mm_loadu_pd(xs + i);
+                const __m128d y = _mm_loadu_pd(ys + i);
+                const __m128d bx = floor(x);
+                const __m128d by = floor(y);
+                const __m128d ix = _mm_sub_pd(x, bx);
+                const __m128d iy = _mm_sub_pd(y, by);
+                const __m128d ix1 = _mm_sub_pd(ix, one);
+                const __m128d iy1 = _mm_sub_pd(iy, one);
+
+                _mm_store_pd(bxs, bx);
+                _mm_store_pd(bys, by);
+                _mm_store_pd(bxs1, _mm_add_pd(bx, one));
+                _mm_store_pd(bys1, _mm_add_pd(by, one));
+                gatherGradients(hash, bxs, bys, gx[0], gy[0], 2);
+                gatherGradients(hash, bxs, bys1, gx[1], gy[1], 2);
+                gatherGradients(hash, bxs1, bys, gx[2], gy[2], 2);
+                gatherGradients(hash, bxs1, bys1, gx[3], gy[3], 2);
+
+                const __m128d d00 = _mm_add_pd(_mm_mul_pd(ix, _mm_load_pd(gx[0])), _mm_mul_pd(iy, _mm_load_pd(gy[0])));
+                const __m128d d01 = _mm_add_pd(_mm_mul_pd(ix, _mm_load_pd(gx[1])), _mm_mul_pd(iy1, _mm_load_pd(gy[1])));
+                const __m128d d10 = _mm_add_pd(_mm_mul_pd(ix1, _mm_load_pd(gx[2])), _mm_mul_pd(iy, _mm_load_pd(gy[2])));
+                const __m128d d11 = _mm_add_pd(_mm_mul_pd(ix1, _mm_load_pd(gx[3])), _mm_mul_pd(iy1, _mm_load_pd(gy[3])));
+
+                const __m128d u = fade(ix);
+                _mm_storeu_pd(out + i, lerp(lerp(d00, d10, u), lerp(d01, d11, u), fade(iy)));
+            }
+
+            for (; i < n; i++) out[i] = perlinPoint(xs[i], ys[i], hash);
+        }
+    } // namespace sse2
+
+    //      //
+    // AVX2 //
+    //      //
+
+    namespace avx2
+    {
+        ZMATH_TARGET_AVX2 inline __m256d fade(__m256d t)
+        {
+            const __m256d inner = _mm256_add_pd(_mm256_mul_pd(t, _mm256_sub_pd(_mm256_mul_pd(t, _mm256_set1_pd(6.0)), _mm256_set1_pd(15.0))), _mm256_set1_pd(10.0));
+            return _mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(t, t), t), inner);
+        }
+
+        ZMATH_TARGET_AVX2 inline __m256d lerp(__m256d a, __m256d b, __m256d t)
+        {
+            return _mm256_add_pd(_mm256_mul_pd(t, b), _mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(1.0), t), a));
+        }
+
+        ZMATH_TARGET_AVX2 inline __m256d simplexCorner(__m256d x, __m256d y, __m256d cx, __m256d cy, const NoiseHash& hash)
+        {
+            alignas(32) double cxs[4], cys[4], gxs[4], gys[4];
+            _mm256_store_pd(cxs, cx);
+            _mm256_store_pd(cys, cy);
+            gatherGradients(hash, cxs, cys, gxs, gys, 4);
+
+            const __m256d t = _mm256_mul_pd(_mm256_add_pd(cx, cy), _mm256_set1_pd(simplex::G2D));
+            const __m256d dx = _mm256_sub_pd(x, _mm256_sub_pd(cx, t));
+            const __m256d dy = _mm256_sub_pd(y, _mm256_sub_pd(cy, t));
+
+            const __m256d d2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+            const __m256d f = _mm256_max_pd(_mm256_sub_pd(_mm256_set1_pd(SIMPLEX_R2), d2), _mm256_setzero_pd());
+            const __m256d f2 = _mm256_mul_pd(f, f);
+            const __m256d dot = _mm256_add_pd(_mm256_mul_pd(dx, _mm256_load_pd(gxs)), _mm256_mul_pd(dy, _mm256_load_pd(gys)));
+            return _mm256_mul_pd(_mm256_mul_pd(f2, f2), dot);
+        }
+
+        ZMATH_TARGET_AVX2 void SimplexPoints(const double* xs, const double* ys, double* out, size_t n, const NoiseHash& hash)
+        {
+            const __m256d one = _mm256_set1_pd(1.0);
+
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                const __m256d x = _mm256_loadu_pd(xs + i);
+                const __m256d y = _mm256_loadu_pd(ys + i);
+                const __m256d s = _mm256_mul_pd(_mm256_add_pd(x, y), _mm256_set1_pd(simplex::F2D));
+                const __m256d sx = _mm256_add_pd(x, s);
+                const __m256d sy = _mm256_add_pd(y, s);
+                const __m256d bx = _mm256_floor_pd(sx);
+                const __m256d by = _mm256_floor_pd(sy);
+                const __m256d lower = _mm256_cmp_pd(_mm256_sub_pd(sx, bx), _mm256_sub_pd(sy, by), _CMP_GT_OQ);
+
+                __m256d Z = _mm256_setzero_pd();
+                Z = _mm256_add_pd(Z, simplexCorner(x, y, bx, by, hash));
+                Z = _mm256_add_pd(Z, simplexCorner(x, y,
+                    _mm256_add_pd(bx, _mm256_and_pd(lower, one)),
+                    _mm256_add_pd(by, _mm256_andnot_pd(lower, one)), hash));
+                Z = _mm256_add_pd(Z, simplexCorner(x, y, _mm256_add_pd(bx, one), _mm256_add_pd(by, one), hash));
+                _mm256_storeu_pd(out + i, Z);
+            }
+
+            for (; i < n; i++) out[i] = simplexPoint(xs[i], ys[i], hash);
+        }
+
+        ZMATH_TARGET_AVX2 void PerlinPoints(const double* xs, const double* ys, double* out, size_t n, const NoiseHash& hash)
+        {
+            const __m256d one = _mm256_set1_pd(1.0);
+            alignas(32) double bxs[4], bys[4], bxs1[4], bys1[4];
+            alignas(32) double gx[4][4], gy[4][4];
+
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                const __m256d x = _mm256_loadu_pd(xs + i);
+                const __m256d y = _mm256_loadu_pd(ys + i);
+                const __m256d bx = _mm256_floor_pd(x);
+                const __m256d by = _mm256_floor_pd(y);
+                const __m256d ix = _mm256_sub_pd(x, bx);
+                const __m256d iy = _mm256_sub_pd(y, by);
+                const __m256d ix1 = _mm256_sub_pd(ix, one);
+                const __m256d iy1 = _mm256_sub_pd(iy, one);
+
+                _mm256_store_pd(bxs, bx);
+                _mm256_store_pd(bys, by);
+                _mm256_store_pd(bxs1, _mm256_add_pd(bx, one));
+                _mm256_store_pd(bys1, _mm256_add_pd(by, one));
+                gatherGradients(hash, bxs, bys, gx[0], gy[0], 4);
+                gatherGradients(hash, bxs, bys1, gx[1], gy[1], 4);
+                gatherGradients(hash, bxs1, bys, gx[2], gy[2], 4);
+                gatherGradients(hash, bxs1, bys1, gx[3], gy[3], 4);
+
+                const __m256d d00 = _mm256_add_pd(_mm256_mul_pd(ix, _mm256_load_pd(gx[0])), _mm256_mul_pd(iy, _mm256_load_pd(gy[0])));
+                const __m256d d01 = _mm256_add_pd(_mm256_mul_pd(ix, _mm256_load_pd(gx[1])), _mm256_mul_pd(iy1, _mm256_load_pd(gy[1])));
+                const __m256d d10 = _mm256_add_pd(_mm256_mul_pd(ix1, _mm256_load_pd(gx[2])), _mm256_mul_pd(iy, _mm256_load_pd(gy[2])));
+                const __m256d d11 = _mm256_add_pd(_mm256_mul_pd(ix1, _mm256_load_pd(gx[3])), _mm256_mul_pd(iy1, _mm256_load_pd(gy[3])));
+
+                const __m256d u = fade(ix);
+                _mm256_storeu_pd(out + i, lerp(lerp(d00, d10, u), lerp(d01, d11, u), fade(iy)));
+            }
+
+            for (; i < n; i++) out[i] = perlinPoint(xs[i], ys[i], hash);
+        }
+    } // namespace avx2
+#endif // ZMATH_SIMD_X86
+
+    //        //
+    // SCALAR //
+    //        //
+
+    namespace scalar
+    {
+        void SimplexPoints(const double* xs, const double* ys, double* out, size_t n, const NoiseHash& hash)
+        {
+            for (size_t i = 0; i < n; i++) out[i] = simplexPoint(xs[i], ys[i], hash);
+        }
+
+        void PerlinPoints(const double* xs, const double* ys, double* out, size_t n, const NoiseHash& hash)
+        {
+            for (size_t i = 0; i < n; i++) out[i] = perlinPoint(xs[i], ys[i], hash);
+        }
+    } // namespace scalar
+}
+
+double SimplexPoint(Vec coord, NoiseHash& hash)
+{
+    return simplexPoint(coord.X, coord.Y, hash);
 }
 
 double PerlinPoint(Vec coord, NoiseHash& hash)
 {
-    VecInt base = coord.Floor();
-    Vec itl = coord - coord.Floor();
-    
-    double dots[2][2];
-    dots[0][0] = itl.Dot(hash[base]);
-    dots[0][1] = (itl - VecInt(0, 1)).Dot(hash[base + VecInt(0, 1)]);
-    dots[1][0] = (itl - VecInt(1, 0)).Dot(hash[base + VecInt(1, 0)]);
-    dots[1][1] = (itl - VecInt(1, 1)).Dot(hash[base + VecInt(1, 1)]);
-
-    return interp5(
-        interp5(dots[0][0], dots[1][0], itl.X),
-        interp5(dots[0][1], dots[1][1], itl.X),
-        itl.Y
-    );
+    return perlinPoint(coord.X, coord.Y, hash);
+}
+
+void SimplexPoints(const double* xs, const double* ys, double* out, size_t n, const NoiseHash& hash)
+{
+    ZMATH_DISPATCH(avx2::SimplexPoints, sse2::SimplexPoints, scalar::SimplexPoints, xs, ys, out, n, hash)
+}
+
+void PerlinPoints(const double* xs, const double* ys, double* out, size_t n, const NoiseHash& hash)
+{
+    ZMATH_DISPATCH(avx2::PerlinPoints, sse2::PerlinPoints, scalar::PerlinPoints, xs, ys, out, n, hash)
 }
 
 } // namespace zmath
@@ -0,0 +1,242 @@
+#include <zarks/image/PaletteIndex.h>
+#include <zarks/internal/parallel.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace zmath
+{
+
+namespace
+{
+	// Tree nodes with this many entries or fewer are scanned directly
+	constexpr int LEAF_SIZE = 4;
+
+	int squaredDistance(const int rgb[3], RGBA col)
+	{
+		const int dR = rgb[0] - col.R;
+		const int dG = rgb[1] - col.G;
+		const int dB = rgb[2] - col.B;
+		return dR * dR + dG * dG + dB * dB;
+	}
+}
+
+PaletteIndex::PaletteIndex(const std::vector<RGBA>& palette, int cubeBits)
+	: palette(palette)
+	, order(palette.size())
+	, cubeBits(cubeBits)
+{
+	if (palette.empty())
+	{
+		throw std::runtime_error("PaletteIndex: the palette is empty!");
+	}
+	if (cubeBits != 0 && cubeBits != 5 && cubeBits != 6)
+	{
+		throw std::runtime_error("PaletteIndex: the cube takes 5 or 6 bits per channel!");
+	}
+	if (cubeBits && palette.size() > 65536)
+	{
+		throw std::runtime_error("PaletteIndex: palettes over 65536 colors can't use the cube!");
+	}
+
+	for (size_t i = 0; i < order.size(); i++) order[i] = (int)i;
+	build(0, (int)order.size());
+
+	if (cubeBits) buildCube();
+}
+
+const std::vector<RGBA>& PaletteIndex::Palette() const
+{
+	return palette;
+}
+
+int PaletteIndex::CubeBits() const
+{
+	return cubeBits;
+}
+
+int PaletteIndex::Nearest(RGBA col) const
+{
+	const int rgb[3] = { col.R, col.G, col.B };
+	int best = -1;
+	int bestDist = INT_MAX;
+
+	if (cubeBits)
+	{
+		// Entries are stored in index order, so the first of equals wins
+		const int shift = 8 - cubeBits;
+		const size_t cell = ((size_t)(col.R >> shift) << (2 * cubeBits))
+		                  | ((size_t)(col.G >> shift) << cubeBits)
+		                  | (size_t)(col.B >> shift);
+
+		for (uint32_t i = cellStart[cell]; i < cellStart[cell + 1]; i++)
+		{
+			const int d = squaredDistance(rgb, palette[cellEntries[i]]);
+			if (d < bestDist)
+			{
+				best = cellEntries[i];
+				bestDist = d;
+			}
+		}
+		return best;
+	}
+
+	search(0, rgb, best, bestDist);
+	return best;
+}
+
+// Builds the subtree over order[begin, end), splitting on the channel with
+// the widest spread, and returns its node's index
+int PaletteIndex::build(int begin, int end)
+{
+	const int id = (int)nodes.size();
+	nodes.push_back(Node{ begin, end, -1, 0, -1, -1 });
+
+	if (end - begin <= LEAF_SIZE) return id;
+
+	int axis = 0, widest = 0;
+	for (int c = 0; c < 3; c++)
+	{
+		auto range = std::minmax_element(order.begin() + begin, order.begin() + end, [&](int a, int b) {
+			return palette[a][c] < palette[b][c];
+		});
+		const int spread = palette[*range.second][c] - palette[*range.first][c];
+		if (spread > widest)
+		{
+			axis = c;
+			widest = spread;
+		}
+	}
+
+	// Identical colors can't be split
+	if (widest == 0) return id;
+
+	const int mid = (begin + end) / 2;
+	std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](int a, int b) {
+		return palette[a][axis] < palette[b][axis];
+	});
+
+	const int split = palette[order[mid]][axis];
+	const int left = build(begin, mid);
+	const int right = build(mid, end);
+
+	nodes[id].axis = axis;
+	nodes[id].split = split;
+	nodes[id].left = left;
+	nodes[id].right = right;
+	return id;
+}
+
+void PaletteIndex::search(int id, const int rgb[3], int& best, int& bestDist) const
+{
+	const Node& node = nodes[id];
+
+	if (node.axis < 0)
+	{
+		for (int i = node.begin; i < node.end; i++)
+		{
+			const int d = squaredDistance(rgb, palette[order[i]]);
+			if (d < bestDist || (d == bestDist && order[i] < best))
+			{
+				best = order[i];
+				bestDist = d;
+			}
+		}
+		return;
+	}
+
+	// The near side first; the far side only if it could hold an equal or
+	// closer entry, since ties go to the lowest index wherever it is
+	const int diff = rgb[node.axis] - node.split;
+	search(diff <= 0 ? node.left : node.right, rgb, best, bestDist);
+	if (diff * diff <= bestDist)
+	{
+		search(diff <= 0 ? node.right : node.left, rgb, best, bestDist);
+	}
+}
+
+// For each cell, an entry can only be nearest to some color in it if its
+// distance to the cell's box is no more than the smallest distance within
+// which some entry covers the whole box. Distances are squared throughout.
+void PaletteIndex::buildCube()
+{
+	const int side = 1 << cubeBits;
+	const int cellSize = 1 << (8 - cubeBits);
+	const int count = (int)palette.size();
+
+	// Per channel, cell coordinate and entry: the nearest and farthest
+	// squared distance along that channel from the entry to the cell
+	std::vector<int> minPart((size_t)3 * side * count), maxPart((size_t)3 * side * count);
+	for (int c = 0; c < 3; c++)
+	{
+		for (int s = 0; s < side; s++)
+		{
+			const int lo = s * cellSize, hi = lo + cellSize - 1;
+			for (int e = 0; e < count; e++)
+			{
+				const int v = palette[e][c];
+				const int near = v < lo ? lo - v : v > hi ? v - hi : 0;
+				const int far = std::max(std::abs(v - lo), std::abs(v - hi));
+				minPart[((size_t)c * side + s) * count + e] = near * near;
+				maxPart[((size_t)c * side + s) * count + e] = far * far;
+			}
+		}
+	}
+
+	// Each slab of cells with the same red coordinate is built on its own
+	std::vector<std::vector<uint16_t>> slabEntries(side);
+	std::vector<std::vector<uint32_t>> slabCounts(side);
+
+	ParallelFor(0, side, [&](int begin, int end) {
+		for (int r = begin; r < end; r++)
+		{
+			slabCounts[r].reserve((size_t)side * side);
+			const int* minR = &minPart[((size_t)0 * side + r) * count];
+			const int* maxR = &maxPart[((size_t)0 * side + r) * count];
+
+			for (int g = 0; g < side; g++)
+			{
+				const int* minG = &minPart[((size_t)1 * side + g) * count];
+				const int* maxG = &maxPart[((size_t)1 * side + g) * count];
+
+				for (int b = 0; b < side; b++)
+				{
+					const int* minB = &minPart[((size_t)2 * side + b) * count];
+					const int* maxB = &maxPart[((size_t)2 * side + b) * count];
+
+					int bound = INT_MAX;
+					for (int e = 0; e < count; e++) bound = std::min(bound, maxR[e] + maxG[e] + maxB[e]);
+
+					uint32_t found = 0;
+					for (int e = 0; e < count; e++)
+					{
+						if (minR[e] + minG[e] + minB[e] <= bound)
+						{
+							slabEntries[r].push_back((uint16_t)e);
+							found++;
+						}
+					}
+					slabCounts[r].push_back(found);
+				}
+			}
+		}
+	}, side * side * count);
+
+	cellStart.assign((size_t)side * side * side + 1, 0);
+	cellEntries.clear();
+
+	size_t cell = 0;
+	for (int r = 0; r < side; r++)
+	{
+		cellEntries.insert(cellEntries.end(), slabEntries[r].begin(), slabEntries[r].end());
+		for (uint32_t found : slabCounts[r])
+		{
+			cellStart[cell + 1] = cellStart[cell] + found;
+			cell++;
+		}
+	}
+}
+
+} // namespace zmath
@@ -0,0 +1,164 @@
+#include <zarks/math/SummedArea.h>
+#include <zarks/image/Image.h>
+#include <zarks/internal/parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+
+namespace zmath
+{
+
+SummedArea::SummedArea(VecInt bounds, int channels, bool squares)
+	: bounds(VecInt::Max(bounds, VecInt(0, 0)))
+	, channels(channels)
+	, hasSquares(squares)
+	, reference(channels, 0.0)
+	, sums((size_t)(this->bounds.X + 1) * (this->bounds.Y + 1) * channels)
+{
+	if (hasSquares) this->squares.resize(sums.size());
+}
+
+SummedArea::SummedArea(const Map& map, bool squares)
+	: SummedArea(map.Bounds(), 1, squares)
+{
+	build([&](int x, int y, int) { return map[x][y]; });
+}
+
+SummedArea::SummedArea(const Image& img, bool squares)
+	: SummedArea(img.Bounds(), 4, squares)
+{
+	build([&](int x, int y, int c) { return (double)img[x][y][c]; });
+}
+
+// Each x-line is first summed along y on its own, then the lines are summed
+// along x in bands of y. Both halves are parallel, and every entry is written
+// by one thread only.
+//
+// Values are stored relative to the first pixel's, so that an offset shared
+// by the whole source can't swamp the squares: the variance is found by
+// subtracting two sums of squares, which cancels badly when both are huge.
+template <typename Value>
+void SummedArea::build(Value value)
+{
+	if (bounds.Area() == 0) return;
+	for (int c = 0; c < channels; c++) reference[c] = value(0, 0, c);
+
+	ForEachLine(bounds, [&](int x) {
+		for (int c = 0; c < channels; c++)
+		{
+			double sum = 0, square = 0;
+			for (int y = 0; y < bounds.Y; y++)
+			{
+				const double v = value(x, y, c) - reference[c];
+				sum += v;
+				sums[index(x + 1, y + 1, c)] = sum;
+
+				if (hasSquares)
+				{
+					square += v * v;
+					squares[index(x + 1, y + 1, c)] = square;
+				}
+			}
+		}
+	});
+
+	ParallelFor(1, bounds.Y + 1, [&](int begin, int end) {
+		for (int x = 2; x <= bounds.X; x++)
+		{
+			for (int y = begin; y < end; y++)
+			{
+				for (int c = 0; c < channels; c++)
+				{
+					sums[index(x, y, c)] += sums[index(x - 1, y, c)];
+					if (hasSquares) squares[index(x, y, c)] += squares[index(x - 1, y, c)];
+				}
+			}
+		}
+	}, bounds.X * channels);
+}
+
+VecInt SummedArea::Bounds() const
+{
+	return bounds;
+}
+
+int SummedArea::Channels() const
+{
+	return channels;
+}
+
+int SummedArea::Count(Rect rect) const
+{
+	VecInt min, max;
+	if (!clip(rect, min, max)) return 0;
+	return (max - min).Area();
+}
+
+double SummedArea::Sum(Rect rect, int channel) const
+{
+	VecInt min, max;
+	if (!clip(rect, min, max)) return 0;
+	// total() checks the channel, so it goes first
+	const double sum = total(sums, min, max, channel);
+	return sum + reference[channel] * (max - min).Area();
+}
+
+double SummedArea::Mean(Rect rect, int channel) const
+{
+	VecInt min, max;
+	if (!clip(rect, min, max)) return 0;
+	const double sum = total(sums, min, max, channel);
+	return sum / (max - min).Area() + reference[channel];
+}
+
+double SummedArea::Variance(Rect rect, int channel) const
+{
+	if (!hasSquares)
+	{
+		throw std::runtime_error("SummedArea: built without squares, so it has no variance!");
+	}
+
+	VecInt min, max;
+	if (!clip(rect, min, max)) return 0;
+
+	const double n = (max - min).Area();
+	if (n < 2) return 0;
+
+	const double sum = total(sums, min, max, channel);
+	const double square = total(squares, min, max, channel);
+
+	// Rounding can leave a flat region very slightly negative
+	return std::max(0.0, (square - sum * sum / n) / (n - 1));
+}
+
+Rect SummedArea::Window(VecInt center, int radius)
+{
+	return Rect(center - radius, center + radius + 1);
+}
+
+size_t SummedArea::index(int x, int y, int channel) const
+{
+	return ((size_t)x * (bounds.Y + 1) + y) * channels + channel;
+}
+
+double SummedArea::total(const std::vector<double>& table, VecInt min, VecInt max, int channel) const
+{
+	if (channel < 0 || channel >= channels)
+	{
+		throw std::runtime_error("SummedArea: no such channel!");
+	}
+
+	return table[index(max.X, max.Y, channel)] - table[index(min.X, max.Y, channel)]
+	     - table[index(max.X, min.Y, channel)] + table[index(min.X, min.Y, channel)];
+}
+
+// Converts 'rect' to whole pixels within bounds; false if none are left
+bool SummedArea::clip(Rect rect, VecInt& min, VecInt& max) const
+{
+	min = Vec::Max(Vec(0, 0), Vec::Min(bounds, rect.min.Ceil()));
+	max = Vec::Max(Vec(0, 0), Vec::Min(bounds, rect.max.Ceil()));
+	return min.X < max.X && min.Y < max.Y;
+}
+
+} // namespace zmath
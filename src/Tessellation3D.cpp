@@ -2,6 +2,7 @@
 #include <zarks/math/binary.h>
 #include <zarks/math/numerals.h>
 #include <zarks/internal/zmath_internals.h>
+#include <zarks/internal/progress.h>
 
 #include <cstring>
 
@@ -191,10 +192,8 @@ namespace zmath
 		return *this;
 	}
 
-	void Tessellation3D::WriteSTL(std::ofstream& f, bool normals, int beginning, int end) const
+	void Tessellation3D::WriteSTL(std::ofstream& f, bool normals, int beginning, int end, const ProgressFn& progressFn) const
 	{
-		std::cout << "Writing STL file with " << data.size() << " triangles!\n";
-
 		const char headerBytes[80]{ "ZarkLib STL file, generated from a Shape3D!" };
 
 		char attribBytes[2]{};
@@ -212,8 +211,10 @@ namespace zmath
 		ToBytes(triCt, (uint32_t)(end - beginning), Endian::Little);
 		f.write((char*)triCt, 4);
 
+		Progress progress(progressFn, "WriteSTL", end - beginning);
+
 		// Write triangle data to file
-		for (int i = beginning; i < end; i++)
+		for (int i = beginning; i < end && !progress.Stopped(); i++)
 		{
 			const Triangle3D& tri = data[i];
 
@@ -241,7 +242,7 @@ namespace zmath
 				}
 				else
 				{
-					std::cout << "Malformed triangle; could not compute normal:\n" << tri << "\n";
+					// Malformed triangle; its normal is left as zero
 					for (int i = 0; i < 12; i++) normBytes[i] = 0;
 				}
 			}
@@ -255,10 +256,13 @@ namespace zmath
 
 			// Write the (blank) attribute byte count
 			f.write((char*)attribBytes, 2);
+
+			progress.Step();
 		}
+		progress.Finish();
 	}
 
-	void Tessellation3D::WriteSTL(std::string filepath, bool normals, int beginning, int end) const
+	void Tessellation3D::WriteSTL(std::string filepath, bool normals, int beginning, int end, const ProgressFn& progressFn) const
 	{
 		std::ofstream fout(filepath, std::ios_base::binary);
 
@@ -267,7 +271,7 @@ namespace zmath
 			throw std::runtime_error("Could not open file at " + filepath);
 		}
 
-		WriteSTL(fout, normals, beginning, end);
+		WriteSTL(fout, normals, beginning, end, progressFn);
 	}
 
 	Tessellation3D Tessellation3D::Square(double size, Vec3 center)
@@ -517,24 +521,23 @@ namespace zmath
 		f.write((char*)buf, 4);
 	}
 
-	Tessellation3D Tessellation3D::LoadSTL(std::ifstream& f)
+	Tessellation3D Tessellation3D::LoadSTL(std::ifstream& f, const ProgressFn& progressFn)
 	{
 		Tessellation3D tess;
 
 		// Load the header
 		char header[81]{};
 		f.read(header, 80);
-		std::cout << "Opened STL File!\n";
-		std::cout << " -> Header:   " << header << "\n";
 
 		// Load the triangle count
 		char triCtBytes[4];
 		f.read(triCtBytes, 4);
 		uint32_t triCt = FromBytes<uint32_t>(triCtBytes, Endian::Little);
-		std::cout << " -> Triangles: " << triCt << "\n";
+
+		Progress progress(progressFn, "LoadSTL", triCt);
 
 		// Load triangles
-		for (uint32_t i = 0; i < triCt; i++)
+		for (uint32_t i = 0; i < triCt && !progress.Stopped(); i++)
 		{
 			char floatBytes[4];
 
@@ -569,7 +572,10 @@ namespace zmath
 			{
 				throw std::runtime_error("Invalid stream while reading STL!");
 			}
+
+			progress.Step();
 		}
+		progress.Finish();
 
 		return tess;
 	}
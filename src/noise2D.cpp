@@ -2,13 +2,15 @@
 #include <zarks/noise/NoiseHash.h>
 #include <zarks/internal/zmath_internals.h>
 #include <zarks/internal/noise_internals.h>
+#include <zarks/internal/parallel.h>
+#include <zarks/internal/progress.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
-#include <random>
-#include <unordered_map>
-#include <iostream>
+#include <limits>
 #include <utility>
+#include <vector>
 
 namespace zmath
 {
@@ -42,42 +44,391 @@ namespace zmath
 		seed = std::chrono::system_clock::now().time_since_epoch().count();
 	}
 
-	Map Simplex(const NoiseConfig& cfg)
+	// Lays Perlin boxes of (possibly fractional) size 'boxSize' along an axis,
+	// box n covering the pixels [floor(n * boxSize), floor((n + 1) * boxSize)).
+	// For each of the 'length' pixels from 'origin' on, stores the index of the
+	// box it falls in and its position within that box, from 0 up to (but
+	// excluding) 1. Pixels get the same box wherever a map starts. If 'slope'
+	// is given, it receives d(itl)/d(pixel), the inverse of each pixel's box size.
+	static void perlinAxis(int origin, int length, double boxSize, std::vector<int>& box, std::vector<double>& itl,
+	                       std::vector<double>* slope = nullptr)
 	{
-		// Helpful constant
-		const double r2 = cfg.r * cfg.r;
+		box.resize(length);
+		itl.resize(length);
+		if (slope) slope->resize(length);
 
-		// RNG
-		NoiseHash hash(cfg.seed);
+		for (int i = 0; i < length; i++)
+		{
+			const int p = origin + i;
 
-		// Map setup
-		Map map(cfg.bounds);
+			// Guess, then correct for rounding
+			int n = (int)std::floor(p / boxSize);
+			while (std::floor((n + 1) * boxSize) <= p) n++;
+			while (std::floor(n * boxSize) > p) n--;
+
+			// The size of this particular box. This can vary by 1 if boxSize is
+			// not a whole number, which is quite common.
+			const double base = std::floor(n * boxSize);
+			const double thisBoxSize = std::floor((n + 1) * boxSize) - base;
+
+			box[i] = n;
+			itl[i] = (p - base) / thisBoxSize;
+			if (slope) (*slope)[i] = 1.0 / thisBoxSize;
+		}
+	}
+
+	namespace
+	{
+		// One octave of a generator. Every generator computes all of a pixel's
+		// octaves together, summing them in octave order, so each pixel is
+		// written once instead of being read and rewritten once per octave.
+		typedef struct Octave {
+			double influence; // weight of this octave in the sum
+			Vec scale;        // lattice units per pixel
+			Vec boxSize;      // Perlin box size in pixels
+			NoiseHash hash;   // this octave's gradients
+		} Octave;
+
+		std::vector<Octave> makeOctaves(const NoiseConfig& cfg)
+		{
+			std::vector<Octave> octaves;
+			NoiseHash hash(cfg.seed);
+
+			for (int oct = 0; oct < cfg.octaves; oct++)
+			{
+				// Move on to fresh gradients for every octave
+				hash.Clear();
+
+				// Calculate the influence of this octave on the overall noise map.
+				// Influence most commonly decreases by a factor of 2 each octave.
+				double influence = std::pow(cfg.octDecrease, oct);
+
+				// Calculate vector with which to scale coordinates this octave.
+				Vec scale = (Vec(1.0, 1.0) / cfg.boxSize) / std::pow(0.5, oct);
+
+				octaves.push_back(Octave{ influence, scale, cfg.boxSize * influence, hash });
+			}
+
+			return octaves;
+		}
+
+		// Cells searched around a pixel's own cell by Worley noise, nearest
+		// ring first so that the outer rings can usually be skipped
+		std::vector<Vec> worleyCells()
+		{
+			std::vector<Vec> cells;
+			for (int ring = 0; ring <= 2; ring++)
+				for (int x = -ring; x <= ring; x++)
+					for (int y = -ring; y <= ring; y++)
+						if (std::max(std::abs(x), std::abs(y)) == ring)
+							cells.push_back(Vec(x, y));
+			return cells;
+		}
+
+		// Worley noise looks at 25 cells, so there are never more distances than this
+		constexpr int WORLEY_MAX_K = 25;
+
+		// Keeps the k smallest of a stream of distances, sorted low to high,
+		// which is all Worley noise needs of the 25 it could compute
+		class NearestK
+		{
+		public:
+			NearestK(int k)
+				: k(std::max(1, std::min(k, WORLEY_MAX_K)))
+				, count(0)
+			{}
+
+			void Reset()
+			{
+				count = 0;
+			}
+
+			bool Full() const
+			{
+				return count == k;
+			}
+
+			// The largest value kept, once Full()
+			double Kth() const
+			{
+				return best[k - 1];
+			}
+
+			// Whether a distance of at least 'bound' could still make the cut,
+			// given the distance the k-th value stands for
+			bool Wants(double bound, double kthDistance) const
+			{
+				// Cells are only skipped when they clearly can't win, so that
+				// rounding in LNorm can never change which distances are kept
+				return count < k || bound <= kthDistance * (1.0 + 1e-9);
+			}
+
+			// Replaces every kept value v with f(v); f must preserve order
+			template <typename F>
+			void Apply(F f)
+			{
+				for (int i = 0; i < count; i++) best[i] = f(best[i]);
+			}
+
+			void Insert(double distance)
+			{
+				if (count == k)
+				{
+					if (!(distance < best[k - 1])) return;
+					count--;
+				}
+
+				int i = count++;
+				for (; i > 0 && best[i - 1] > distance; i--)
+				{
+					best[i] = best[i - 1];
+				}
+				best[i] = distance;
+			}
+
+			// Product of the distances ranked [first, last)
+			double Product(int first, int last) const
+			{
+				double Z = 1;
+				for (int i = first; i < std::min(last, count); i++)
+				{
+					Z *= best[i];
+				}
+				return Z;
+			}
+
+		private:
+			const int k;
+			int count;
+			double best[WORLEY_MAX_K];
+		};
+
+		// A lower bound on the distance from 'itl' to the feature point of the
+		// cell at 'cell'. That point lies within a unit vector of the cell's
+		// corner, so no coordinate can be closer than the corner's less one.
+		// Any LNorm with L > 0 is at least the largest coordinate.
+		inline double worleyBound(Vec cell, Vec itl)
+		{
+			return std::max(std::abs(cell.X - itl.X), std::abs(cell.Y - itl.Y)) - 1.0;
+		}
+
+		// Distance functions for NoiseConfig::lNorm. Generators pick one per
+		// map with withNorm() and are compiled for it, so L1, L2 and L-infinity
+		// need no std::pow. Each matches Vec::LNorm and also gives the gradient
+		// of the squared distance, given dist = norm(d), for SimplexGradient.
+		// Root(Powered(d)) is the same distance, split so that Worley can rank
+		// distances by Powered(d), which orders them alike, and take the root
+		// of only the few it keeps.
+		typedef struct NormL1 {
+			double operator()(Vec d) const
+			{
+				return std::abs(d.X) + std::abs(d.Y);
+			}
+
+			double Powered(Vec d) const { return (*this)(d); }
+			double Root(double powered) const { return powered; }
+
+			Vec SquaredGradient(Vec d, double dist) const
+			{
+				return Vec(std::copysign(2.0 * dist, d.X), std::copysign(2.0 * dist, d.Y));
+			}
+		} NormL1;
+
+		typedef struct NormL2 {
+			double operator()(Vec d) const
+			{
+				return std::sqrt(d.X * d.X + d.Y * d.Y);
+			}
+
+			double Powered(Vec d) const { return d.X * d.X + d.Y * d.Y; }
+			double Root(double powered) const { return std::sqrt(powered); }
+
+			Vec SquaredGradient(Vec d, double) const
+			{
+				return d * 2.0;
+			}
+		} NormL2;
+
+		typedef struct NormLInf {
+			double operator()(Vec d) const
+			{
+				return std::max(std::abs(d.X), std::abs(d.Y));
+			}
+
+			double Powered(Vec d) const { return (*this)(d); }
+			double Root(double powered) const { return powered; }
+
+			Vec SquaredGradient(Vec d, double dist) const
+			{
+				return std::abs(d.X) >= std::abs(d.Y)
+					? Vec(std::copysign(2.0 * dist, d.X), 0)
+					: Vec(0, std::copysign(2.0 * dist, d.Y));
+			}
+		} NormLInf;
+
+		typedef struct NormLp {
+			double L;
+
+			double operator()(Vec d) const
+			{
+				return Root(Powered(d));
+			}
+
+			// A negative L makes the sum shrink as the distance grows, so it
+			// is negated to keep Powered() in the same order as the distance
+			double Powered(Vec d) const
+			{
+				const double sum = std::pow(std::abs(d.X), L) + std::pow(std::abs(d.Y), L);
+				return L < 0 ? -sum : sum;
+			}
+
+			double Root(double powered) const
+			{
+				return std::pow(L < 0 ? -powered : powered, 1.0 / L);
+			}
+
+			Vec SquaredGradient(Vec d, double dist) const
+			{
+				if (dist == 0) return Vec(0, 0);
+
+				const double scale = 2.0 * std::pow(dist, 2.0 - L);
+				return Vec(std::copysign(std::pow(std::abs(d.X), L - 1), d.X) * scale,
+				           std::copysign(std::pow(std::abs(d.Y), L - 1), d.Y) * scale);
+			}
+		} NormLp;
+
+		// NormLp with fastPow for the powers, for WorleyPlex, where L changes
+		// from pixel to pixel. Only the few distances Worley keeps are rooted,
+		// so Root() stays exact.
+		typedef struct NormLpApprox {
+			double L;
+
+			double operator()(Vec d) const
+			{
+				return Root(Powered(d));
+			}
+
+			double Powered(Vec d) const
+			{
+				const double sum = fastPow(std::abs(d.X), L) + fastPow(std::abs(d.Y), L);
+				return L < 0 ? -sum : sum;
+			}
+
+			double Root(double powered) const
+			{
+				return std::pow(L < 0 ? -powered : powered, 1.0 / L);
+			}
+		} NormLpApprox;
+
+		// Calls f with the distance function for 'lNorm'
+		template <typename F>
+		void withNorm(double lNorm, F&& f)
+		{
+			if (lNorm == 1) f(NormL1());
+			else if (lNorm == 2) f(NormL2());
+			else if (lNorm == std::numeric_limits<double>::infinity()) f(NormLInf());
+			else f(NormLp{ lNorm });
+		}
+
+		// As withNorm, but with fastPow in place of std::pow for other norms
+		template <typename F>
+		void withApproxNorm(double lNorm, F&& f)
+		{
+			if (lNorm == 1) f(NormL1());
+			else if (lNorm == 2) f(NormL2());
+			else if (lNorm == std::numeric_limits<double>::infinity()) f(NormLInf());
+			else f(NormLpApprox{ lNorm });
+		}
 
-		std::cout << "Creating new Simplex Map:\n"
-		          << " -> Width:  " << cfg.bounds.X << "\n"
-		          << " -> Height: " << cfg.bounds.Y << "\n"
-		          << " -> Seed:   " << cfg.seed << "\n";
-		
-		// Dive in
-		for (int oct = 0; oct < cfg.octaves; oct++)
+		// Collects the distances from 'itl' to the Worley points of the cells
+		// around 'base', skipping cells that can't hold one of the nearest.
+		// Candidates are ranked by norm.Powered(); only the current k-th
+		// nearest, which pruning compares against, and the final picks are
+		// turned into distances.
+		template <typename Norm>
+		void worleyNearest(NearestK& nearest, const std::vector<Vec>& coordList, const NoiseHash& hash,
+		                   VecInt base, Vec itl, bool prune, Norm norm)
 		{
-			// Empty the vector hashmap for a new octave
-			hash.Clear();
+			nearest.Reset();
+			double kthPowered = 0;
+			double kthDistance = 0;
+			for (const Vec& cell : coordList)
+			{
+				if (prune && nearest.Full())
+				{
+					if (nearest.Kth() != kthPowered)
+					{
+						kthPowered = nearest.Kth();
+						kthDistance = norm.Root(kthPowered);
+					}
+					if (!nearest.Wants(worleyBound(cell, itl), kthDistance)) continue;
+				}
+
+				VecInt test = base + cell;
+				nearest.Insert(norm.Powered(hash[test] + cell - itl));
+			}
+
+			nearest.Apply([&](double powered) {
+				double distance = norm.Root(powered);
+
+				// uncomment for quantized distance; looks best with lnorm = 2
+				// distance = ((int)(distance * 20.0)) / 20.0;
+
+				return distance;
+			});
+		}
+
+		// Rescales a value map to [0, 1] as Interpolate(0, 1) does, along with
+		// its derivatives
+		template <typename M>
+		void normalizeGradient(M& value, Map& dx, Map& dy)
+		{
+			const auto minmax = value.GetMinMax();
+			const double range = minmax.second - minmax.first;
+
+			value.Interpolate(0, 1);
+			if (range == 0)
+			{
+				dx.Clear(0);
+				dy.Clear(0);
+			}
+			else
+			{
+				dx /= range;
+				dy /= range;
+			}
+		}
+	}
 
-			// Calculate the influence of this octave on the overall noise map.
-			// Influence most commonly decreases by a factor of 2 each octave.
-			double octInfluence = std::pow(cfg.octDecrease, oct);
+	// Generators are shared by the Map and Mapf entry points and write every
+	// pixel of 'map', which must be cfg.bounds, so maps can be reused. The
+	// math is always done in double and only the stored result is narrowed. With
+	// GRAD, Simplex and Perlin also write their exact derivatives with
+	// respect to pixel coordinates to 'dx' and 'dy', which must be cfg.bounds.
+	template <typename M, bool GRAD, typename Norm>
+	static void fillSimplex(M& map, const NoiseConfig& cfg, VecInt origin, const std::vector<Octave>& octaves,
+	                        Map* dx, Map* dy, Norm norm)
+	{
+		// Helpful constant
+		const double r2 = cfg.r * cfg.r;
 
-			// Calculate vector with which to scale coordinates ths octave.
-			Vec scaleVec = (Vec(1.0, 1.0) / cfg.boxSize) / std::pow(0.5, oct);
+		Progress progress(cfg.progress, "Simplex", cfg.bounds.X);
 
-			// Iterate through the whole map
-			for (int x = 0; x < cfg.bounds.X; x++)
+		// Dive in, a band of x-lines per thread
+		ForEachLine(cfg.bounds, [&](int x) {
+			if (progress.Stopped()) return;
+
+			auto* line = writeLine(map, x);
+			double* dxLine = GRAD ? writeLine(*dx, x) : nullptr;
+			double* dyLine = GRAD ? writeLine(*dy, x) : nullptr;
+			for (int y = 0; y < cfg.bounds.Y; y++)
 			{
-				for (int y = 0; y < cfg.bounds.Y; y++)
+				double total = 0;
+				Vec gradient;
+				for (const Octave& octave : octaves)
 				{
 					// Compute input coordinate
-					Vec ipt = scaleVec * Vec(x, y);
+					Vec ipt = octave.scale * Vec(origin.X + x, origin.Y + y);
 					// Compute skewed coordinate
 					Vec skewed = simplex::skew(ipt);
 					// Compute internal simplex coordinate
@@ -97,313 +448,554 @@ namespace zmath
 
 					for (int i = 0; i < 3; i++)
 					{
-						vectors[i] = hash[corners[i]];
+						vectors[i] = octave.hash[corners[i]];
 					}
 
 					// Perform final summation for this coordinate
 					double Z = 0;
+					Vec dZ;
 					for (int i = 0; i < 3; i++)
 					{
 						Vec displacement = ipt - simplex::unskew(corners[i]);
-						double distance = displacement.LNorm(cfg.lNorm); // Distance formula
+						double distance = norm(displacement); // Distance formula
+
+						double falloff = std::max(0.0, r2 - distance * distance);
+						double influence = std::pow(falloff, cfg.rMinus);
+						double dot = displacement.Dot(vectors[i]);
+						Z += influence * dot;
 
-						double influence = std::pow(std::max(0.0, r2 - distance * distance), cfg.rMinus);
-						Z += influence * displacement.Dot(vectors[i]);
+						// Product rule over influence * dot, with respect to ipt
+						if (GRAD && falloff > 0)
+						{
+							double dInfluence = -cfg.rMinus * std::pow(falloff, cfg.rMinus - 1);
+							dZ += norm.SquaredGradient(displacement, distance) * (dInfluence * dot);
+							dZ += vectors[i] * influence;
+						}
 					}
 
-					// Add this coordinate to the map, weighted appropriately
-					map.At(x, y) += Z * octInfluence;
+					// Add this octave to the pixel, weighted appropriately
+					total += Z * octave.influence;
+					if (GRAD) gradient += octave.scale * dZ * octave.influence;
 				}
-			} 
 
-			// Notify octave completion
-			std::cout << " -> Octave \033[1;32m" << oct + 1 << "\033[0m Finished.\r" << std::flush;
-		}
-		std::cout << " -> All done!                       \n";
+				line[y] = total;
+				if (GRAD)
+				{
+					dxLine[y] = gradient.X;
+					dyLine[y] = gradient.Y;
+				}
+			}
 
-		// Perform final normalization, if applicable
-		if (cfg.normalize) map.Interpolate(0, 1);
+			progress.Step();
+		});
+		progress.Finish();
 
-		return map;
+		// Perform final normalization, if applicable
+		if (cfg.normalize)
+		{
+			if (GRAD) normalizeGradient(map, *dx, *dy);
+			else map.Interpolate(0, 1);
+		}
 	}
 
-	Map Perlin(const NoiseConfig& cfg)
+	template <typename M, bool GRAD = false>
+	static void fillSimplex(M& map, const NoiseConfig& cfg, VecInt origin, const std::vector<Octave>& octaves,
+	                        Map* dx = nullptr, Map* dy = nullptr)
 	{
-		// Initialize map
-		Map map(cfg.bounds);
-
-		std::cout << "Generating new Perlin map:\n"
-		          << " -> Width:  " << cfg.bounds.X << "\n"
-		          << " -> Height: " << cfg.bounds.Y << "\n"
-		          << " -> Seed:   " << cfg.seed << "\n";
-
-		// RNG
-		NoiseHash hash(cfg.seed);
+		withNorm(cfg.lNorm, [&](auto norm) { fillSimplex<M, GRAD>(map, cfg, origin, octaves, dx, dy, norm); });
+	}
 
-		// Beep beep so let's ride
-		for (int oct = 0; oct < cfg.octaves; oct++)
+	template <typename M, bool GRAD = false>
+	static void fillPerlin(M& map, const NoiseConfig& cfg, VecInt origin, const std::vector<Octave>& octaves,
+	                       Map* dx = nullptr, Map* dy = nullptr)
+	{
+		Progress progress(cfg.progress, "Perlin", cfg.bounds.X);
+
+		// Walk the boxes along each axis once per octave. Each pixel gets the
+		// index of its box, which names the box's corners in the lattice, and
+		// its internal coordinate within that box, ranging from 0 to 1, along
+		// with the fade of that coordinate. Lines can then be filled in any
+		// order, a band of x-lines per thread.
+		const size_t octs = octaves.size();
+		std::vector<std::vector<int>> boxX(octs), boxY(octs);
+		std::vector<std::vector<double>> itlX(octs), itlY(octs);
+		std::vector<std::vector<double>> fadeX(octs), fadeY(octs);
+		std::vector<std::vector<double>> slopeX(octs), slopeY(octs);
+		for (size_t oct = 0; oct < octs; oct++)
 		{
-			// Empty the vector hashmap for a new octave
-			hash.Clear();
+			// Size of each Perlin box in this octave
+			Vec octaveBoxSize = octaves[oct].boxSize;
 
-			// Determine influence of this octave
-			double octInfluence = std::pow(cfg.octDecrease, oct);
+			perlinAxis(origin.X, cfg.bounds.X, octaveBoxSize.X, boxX[oct], itlX[oct], GRAD ? &slopeX[oct] : nullptr);
+			perlinAxis(origin.Y, cfg.bounds.Y, octaveBoxSize.Y, boxY[oct], itlY[oct], GRAD ? &slopeY[oct] : nullptr);
 
-			// Determine size of each Perlin box in this octave
-			Vec octaveBoxSize = cfg.boxSize * octInfluence;
+			for (double itl : itlX[oct]) fadeX[oct].push_back(fade5(itl));
+			for (double itl : itlY[oct]) fadeY[oct].push_back(fade5(itl));
+		}
 
-			// Loop box-by-box through the map
-			for (double bx = 0, bnx = 0; bx < cfg.bounds.X; bx += octaveBoxSize.X, bnx++)
+		// Beep beep so let's ride
+		ForEachLine(cfg.bounds, [&](int x) {
+			if (progress.Stopped()) return;
+
+			auto* line = writeLine(map, x);
+			double* dxLine = GRAD ? writeLine(*dx, x) : nullptr;
+			double* dyLine = GRAD ? writeLine(*dy, x) : nullptr;
+
+			// The random vectors of the four corners of each octave's current box
+			typedef struct Box {
+				bool valid;
+				int index;
+				Vec corners[2][2];
+			} Box;
+			std::vector<Box> boxes(octs);
+			for (Box& box : boxes) box.valid = false;
+
+			for (int y = 0; y < cfg.bounds.Y; y++)
 			{
-				for (double by = 0, bny = 0; by < cfg.bounds.Y; by += octaveBoxSize.Y, bny++)
+				double total = 0;
+				Vec gradient;
+				for (size_t oct = 0; oct < octs; oct++)
 				{
-					// We are now operating within a single Perlin box.
-					// Here, determine the random vectors of this box's four corners.
-					VecInt base = Vec(bx, by).Floor();
-					Vec corners[2][2];
-					for (int cx = 0; cx <= 1; cx++)
+					// Fetch the random vectors of this box's four corners, once per box
+					Box& box = boxes[oct];
+					if (!box.valid || boxY[oct][y] != box.index)
 					{
-						for (int cy = 0; cy <= 1; cy++)
+						box.valid = true;
+						box.index = boxY[oct][y];
+						for (int cx = 0; cx <= 1; cx++)
 						{
-							// Randomly generate new vectors if not already present
-							VecInt test = VecInt(bnx + cx, bny + cy);
-							corners[cx][cy] = hash[test];
+							for (int cy = 0; cy <= 1; cy++)
+							{
+								box.corners[cx][cy] = octaves[oct].hash[VecInt(boxX[oct][x] + cx, box.index + cy)];
+							}
 						}
 					}
 
-					// With this box's corner vector's determined, we can now loop through
-					// each point within the box to determine how much to add to the heightmap.
+					// Internal coordinate within this box; ranging from (0, 0) to (1, 1)
+					Vec itl(itlX[oct][x], itlY[oct][y]);
 
-					// The size of this particular box. This can vary by 1 if octaveBoxSize is
-					// not a whole number, which is quite common.
-					VecInt thisBoxSize = (Vec(bx, by) + octaveBoxSize).Floor() - Vec(bx, by).Floor();
+					// For each corner, determine the dot product of its random
+					// directional vector with the distance vector from that corner
+					// to the current internal coordinate
 					double dots[2][2];
-					for (int ix = 0; ix < thisBoxSize.X; ix++)
-					{
-						// X Bound check
-						if (base.X + ix > cfg.bounds.X) continue;
+					dots[0][0] = (itl - Vec(0, 0)).Dot(box.corners[0][0]);
+					dots[0][1] = (itl - Vec(0, 1)).Dot(box.corners[0][1]);
+					dots[1][0] = (itl - Vec(1, 0)).Dot(box.corners[1][0]);
+					dots[1][1] = (itl - Vec(1, 1)).Dot(box.corners[1][1]);
 
-						for (int iy = 0; iy < thisBoxSize.Y; iy++)
-						{
-							// Y bound check
-							if (base.Y + iy > cfg.bounds.Y) continue;
-
-							// Internal coordinate within this box; ranging from (0, 0) to (1, 1)
-							Vec itl = Vec(ix, iy) / Vec(thisBoxSize);
-
-							// Absolute coordinate within the larger map
-							VecInt absolute = base + VecInt(ix, iy);
-
-							// For each corner, determine the dot product of its random
-							// directional vector with the distance vector from that corner
-							// to the current internal coordinate
-							dots[0][0] = (itl - Vec(0, 0)).Dot(corners[0][0]);
-							dots[0][1] = (itl - Vec(0, 1)).Dot(corners[0][1]);
-							dots[1][0] = (itl - Vec(1, 0)).Dot(corners[1][0]);
-							dots[1][1] = (itl - Vec(1, 1)).Dot(corners[1][1]);
-
-							// Interpolate dot product results
-							double y0, y1, Z;
-							y0 = interp5(dots[0][0], dots[1][0], itl.X);
-							y1 = interp5(dots[0][1], dots[1][1], itl.X);
-							Z = interp5(y0, y1, itl.Y);
-
-							map.At(absolute) += Z * octInfluence;
-						}
+					// Interpolate dot product results along the faded coordinate
+					const Vec fade(fadeX[oct][x], fadeY[oct][y]);
+					double y0, y1, Z;
+					y0 = interpLinear(dots[0][0], dots[1][0], fade.X);
+					y1 = interpLinear(dots[0][1], dots[1][1], fade.X);
+					Z = interpLinear(y0, y1, fade.Y);
+
+					total += Z * octaves[oct].influence;
+
+					if (GRAD)
+					{
+						// Derivative of the fade curve along each axis
+						const Vec dFade(
+							30 * itl.X * itl.X * (itl.X - 1) * (itl.X - 1),
+							30 * itl.Y * itl.Y * (itl.Y - 1) * (itl.Y - 1));
+
+						const Vec (&g)[2][2] = box.corners;
+
+						// d(y0)/d(itl) and d(y1)/d(itl)
+						const Vec dy0(
+							g[0][0].X + (g[1][0].X - g[0][0].X) * fade.X + (dots[1][0] - dots[0][0]) * dFade.X,
+							g[0][0].Y + (g[1][0].Y - g[0][0].Y) * fade.X);
+						const Vec dy1(
+							g[0][1].X + (g[1][1].X - g[0][1].X) * fade.X + (dots[1][1] - dots[0][1]) * dFade.X,
+							g[0][1].Y + (g[1][1].Y - g[0][1].Y) * fade.X);
+
+						const Vec dZ(
+							dy0.X + (dy1.X - dy0.X) * fade.Y,
+							dy0.Y + (dy1.Y - dy0.Y) * fade.Y + (y1 - y0) * dFade.Y);
+
+						gradient += dZ * Vec(slopeX[oct][x], slopeY[oct][y]) * octaves[oct].influence;
 					}
 				}
-			}
 
-			// Notify octave completion
-			std::cout << " -> Octave \033[1;32m" << oct + 1 << "\033[0m Finished.\r" << std::flush;
-		}
-		std::cout << " -> All done!                       \n";
+				line[y] = total;
+				if (GRAD)
+				{
+					dxLine[y] = gradient.X;
+					dyLine[y] = gradient.Y;
+				}
+			}
 
-		if (cfg.normalize) map.Interpolate(0, 1);
+			progress.Step();
+		});
+		progress.Finish();
 
-		return map;
+		if (cfg.normalize)
+		{
+			if (GRAD) normalizeGradient(map, *dx, *dy);
+			else map.Interpolate(0, 1);
+		}
 	}
 
-	Map Worley(const NoiseConfig& cfg)
+	template <typename M, typename Norm>
+	static void fillWorley(M& map, const NoiseConfig& cfg, VecInt origin, const std::vector<Octave>& octaves, Norm norm)
 	{
 		// this coordList works for simpler algorithms that use fewer than ~5 points
-		std::vector<Vec> coordList;
-		for (int x = -2; x <= 2; x++)
-			for (int y = -2; y <= 2; y++)
-				coordList.push_back(Vec(x, y));
+		const std::vector<Vec> coordList = worleyCells();
+		// Skipping cells is only safe for norms that are at least the largest coordinate
+		const bool prune = cfg.lNorm > 0;
 
-		// RNG
-		NoiseHash hash(cfg.seed);
-
-		std::cout << "Generating new Worley map:\n"
-		          << " -> Width:  " << cfg.bounds.X << "\n"
-		          << " -> Height: " << cfg.bounds.Y << "\n"
-		          << " -> Seed:   " << cfg.seed << "\n";
+		Progress progress(cfg.progress, "Worley", cfg.bounds.X);
 
-		// Initialize map
-		Map map(cfg.bounds);
+		ForEachLine(cfg.bounds, [&](int x) {
+			if (progress.Stopped()) return;
 
-		unsigned distanceLen = coordList.size();
-		std::vector<double> distances(distanceLen);
-
-		for (int oct = 0; oct < cfg.octaves; oct++)
-		{
-			// Empty the vector hashmap for a new octave
-			hash.Clear();
+			auto* line = writeLine(map, x);
+			NearestK nearest(cfg.nearest.second);
 
-			double octInfluence = std::pow(cfg.octDecrease, oct);
-			Vec scaleVec = (Vec(1.0, 1.0) / cfg.boxSize) / std::pow(0.5, oct);
-
-			for (int x = 0; x < cfg.bounds.X; x++)
+			for (int y = 0; y < cfg.bounds.Y; y++)
 			{
-				for (int y = 0; y < cfg.bounds.Y; y++)
+				double total = 0;
+				for (const Octave& octave : octaves)
 				{
-					Vec coord = scaleVec * Vec(x, y);
+					Vec coord = octave.scale * Vec(origin.X + x, origin.Y + y);
 					VecInt base = coord.Floor();
 					Vec itl = coord - base;
 
-					// Get the distances to each point
-					for (unsigned i = 0; i < distanceLen; i++)
-					{
-						VecInt test = base + coordList[i];
-
-						distances[i] = (hash[test] + coordList[i] - itl).LNorm(cfg.lNorm);
-
-						// uncomment for quantized distance; looks best with lnorm = 2
-						// distances[i] = ((int)(distances[i] * 20.0)) / 20.0;
-					}
-
-					// Sort the distances, low to high. TODO: use a better sorting algorithm
-					while (true)
-					{
-						bool done = true;
-						for (unsigned i = 1; i < distanceLen; i++)
-						{
-							if (distances[i - 1] > distances[i])
-							{
-								double temp = distances[i];
-								distances[i] = distances[i - 1];
-								distances[i - 1] = temp;
-								done = false;
-							}
-						}
-						if (done) break;
-					}
+					worleyNearest(nearest, coordList, octave.hash, base, itl, prune, norm);
 
 					// Compute brightness
-					double Z = 1;
-					for (int i = cfg.nearest.first; i < cfg.nearest.second; i++)
-					{
-						Z *= distances[i];
-					}
-					//std::cout << distances[1] << "\n";
+					double Z = nearest.Product(cfg.nearest.first, cfg.nearest.second);
 
 					// Final summation
-					map.At(x, y) += Z * octInfluence;
+					total += Z * octave.influence;
 				}
+
+				line[y] = total;
 			}
 
-			// Notify octave completion
-			std::cout << " -> Octave \033[1;32m" << oct + 1 << "\033[0m Finished.\r" << std::flush;
-		}
-		std::cout << " -> All done!                       \n";
+			progress.Step();
+		});
+		progress.Finish();
 
 		if (cfg.normalize) map.Interpolate(0, 1);
+	}
 
-		return map;
+	template <typename M>
+	static void fillWorley(M& map, const NoiseConfig& cfg, VecInt origin, const std::vector<Octave>& octaves)
+	{
+		withNorm(cfg.lNorm, [&](auto norm) { fillWorley(map, cfg, origin, octaves, norm); });
+	}
+
+	static void fillNoise(NoiseType type, Map& map, const NoiseConfig& cfg, VecInt origin, const std::vector<Octave>& octaves)
+	{
+		switch (type)
+		{
+		case NoiseType::Simplex:
+			fillSimplex(map, cfg, origin, octaves);
+			break;
+		case NoiseType::Perlin:
+			fillPerlin(map, cfg, origin, octaves);
+			break;
+		case NoiseType::Worley:
+			fillWorley(map, cfg, origin, octaves);
+			break;
+		}
 	}
 
 	// WorleyPlex is identical to Worley in almost every way, with the main exception
 	// being that the vector LNorm used to compute distances between points depends on
 	// the values of a passed-in heightmap. This can create some cool effects!
-	Map WorleyPlex(const NoiseConfig& cfg, const Map& baseMap)
+	Map WorleyPlex(const NoiseConfig& cfg, const Map& baseMap, VecInt origin)
 	{
 		if (cfg.bounds != baseMap.Bounds())
 		{
-			std::cout << "Bounds mismatch :/ \n";
-			return Map(baseMap.Bounds());
+			throw std::runtime_error("Map bounds don't match!");
 		}
 
-		std::vector<Vec> coordList;
-		for (int x = -2; x <= 2; x++)
-			for (int y = -2; y <= 2; y++)
-				coordList.push_back(Vec(x, y));
+		const std::vector<Vec> coordList = worleyCells();
 
 		// RNG
-		NoiseHash hash(cfg.seed);
+		const std::vector<Octave> octaves = makeOctaves(cfg);
 
-		std::cout << "Generating new Worleyplex map:\n"
-				  << " -> Width:  " << cfg.bounds.X << "\n"
-				  << " -> Height: " << cfg.bounds.Y << "\n"
-				  << " -> Seed:   " << cfg.seed << "\n";
+		Progress progress(cfg.progress, "WorleyPlex", cfg.bounds.X);
 
 		Map map(cfg.bounds);
 
-		// Allocate this here, no point in constantly de- and re-allocating it in the loop
-		unsigned distanceLen = coordList.size(); // TODO: multiply by config.N once implemented
-		std::vector<double> distances(distanceLen);
-
-		for (int oct = 0; oct < cfg.octaves; oct++)
-		{
-			// Empty the vector hashmap for a new octave
-			hash.Clear();
+		ForEachLine(cfg.bounds, [&](int x) {
+			if (progress.Stopped()) return;
 
-			double octInfluence = std::pow(cfg.octDecrease, oct);
-			Vec scaleVec = (Vec(1.0, 1.0) / cfg.boxSize) / std::pow(0.5, oct);
+			double* line = writeLine(map, x);
+			NearestK nearest(cfg.nearest.second);
 
-			for (int x = 0; x < cfg.bounds.X; x++)
+			for (int y = 0; y < cfg.bounds.Y; y++)
 			{
-				for (int y = 0; y < cfg.bounds.Y; y++)
+				double total = 0;
+				for (const Octave& octave : octaves)
 				{
-					Vec coord = scaleVec * Vec(x, y);
-					Vec base = coord.Floor();
+					Vec coord = octave.scale * Vec(origin.X + x, origin.Y + y);
+					VecInt base = coord.Floor();
 					Vec itl = coord - base;
 
-					// Get the distances to each point
-					for (unsigned i = 0; i < distanceLen; i++)
-					{
-						Vec test = base + coordList[i];
-
-						// This is where the base map is used
-						distances[i] = (hash[test] + coordList[i] - itl).LNorm(baseMap[x][y]);
-					}
+					// This is where the base map is used
+					const double lNorm = baseMap[x][y];
+					const bool prune = lNorm > 0;
 
-					// Sort the distances, low to high. TODO: use a better sorting algorithm
-					while (true)
-					{
-						bool done = true;
-						for (unsigned i = 1; i < distanceLen; i++)
-						{
-							if (distances[i - 1] > distances[i])
-							{
-								double temp = distances[i];
-								distances[i] = distances[i - 1];
-								distances[i - 1] = temp;
-								done = false;
-							}
-						}
-						if (done) break;
-					}
+					withApproxNorm(lNorm, [&](auto norm) {
+						worleyNearest(nearest, coordList, octave.hash, base, itl, prune, norm);
+					});
 
 					// Compute brightness
-					double Z = 1;
-					for (int i = cfg.nearest.first; i < cfg.nearest.second; i++)
-					{
-						Z *= distances[i];
-					}
+					double Z = nearest.Product(cfg.nearest.first, cfg.nearest.second);
 
 					// Final summation
-					map.At(x, y) += Z * octInfluence;
+					total += Z * octave.influence;
 				}
+
+				line[y] = total;
+			}
+
+			progress.Step();
+		});
+		progress.Finish();
+
+		if (cfg.normalize) map.Interpolate(0, 1);
+
+		return map;
+	}
+
+	Map Simplex(const NoiseConfig& cfg, VecInt origin)
+	{
+		Map map(cfg.bounds);
+		fillSimplex(map, cfg, origin, makeOctaves(cfg));
+		return map;
+	}
+
+	Map Perlin(const NoiseConfig& cfg, VecInt origin)
+	{
+		Map map(cfg.bounds);
+		fillPerlin(map, cfg, origin, makeOctaves(cfg));
+		return map;
+	}
+
+	Map Worley(const NoiseConfig& cfg, VecInt origin)
+	{
+		Map map(cfg.bounds);
+		fillWorley(map, cfg, origin, makeOctaves(cfg));
+		return map;
+	}
+
+	Mapf Simplexf(const NoiseConfig& cfg, VecInt origin)
+	{
+		Mapf map(cfg.bounds);
+		fillSimplex(map, cfg, origin, makeOctaves(cfg));
+		return map;
+	}
+
+	Mapf Perlinf(const NoiseConfig& cfg, VecInt origin)
+	{
+		Mapf map(cfg.bounds);
+		fillPerlin(map, cfg, origin, makeOctaves(cfg));
+		return map;
+	}
+
+	Mapf Worleyf(const NoiseConfig& cfg, VecInt origin)
+	{
+		Mapf map(cfg.bounds);
+		fillWorley(map, cfg, origin, makeOctaves(cfg));
+		return map;
+	}
+
+	NoiseGradient::NoiseGradient(VecInt bounds)
+		: value(bounds)
+		, dx(bounds)
+		, dy(bounds)
+	{}
+
+	Map NoiseGradient::Slope() const
+	{
+		Map slope(value.Bounds());
+		ForEachLine(value.Bounds(), [&](int x) {
+			double* line = writeLine(slope, x);
+			for (int y = 0; y < value.Bounds().Y; y++)
+			{
+				line[y] = std::sqrt(dx[x][y] * dx[x][y] + dy[x][y] * dy[x][y]);
 			}
+		});
+		return slope;
+	}
+
+	NoiseGradient SimplexGradient(const NoiseConfig& cfg, VecInt origin)
+	{
+		NoiseGradient result(cfg.bounds);
+		fillSimplex<Map, true>(result.value, cfg, origin, makeOctaves(cfg), &result.dx, &result.dy);
+		return result;
+	}
+
+	NoiseGradient PerlinGradient(const NoiseConfig& cfg, VecInt origin)
+	{
+		NoiseGradient result(cfg.bounds);
+		fillPerlin<Map, true>(result.value, cfg, origin, makeOctaves(cfg), &result.dx, &result.dy);
+		return result;
+	}
+
+	OctaveCache::OctaveCache(NoiseType type)
+		: type(type)
+	{}
+
+	Map OctaveCache::operator()(const NoiseConfig& cfg, VecInt origin)
+	{
+		if (!matches(cfg, origin))
+		{
+			layers.clear();
+			layerCfg = cfg;
+			layerOrigin = origin;
+		}
+
+		const std::vector<Octave> octaves = makeOctaves(cfg);
+
+		// Generate the missing layers, each as a lone octave of weight 1
+		NoiseConfig layerGen = cfg;
+		layerGen.normalize = false;
+		for (int oct = (int)layers.size(); oct < cfg.octaves; oct++)
+		{
+			std::vector<Octave> layerOctave{ octaves[oct] };
+			layerOctave[0].influence = 1;
 
-			// Notify octave completion
-			std::cout << " -> Octave \033[1;32m" << oct + 1 << "\033[0m Finished.\r" << std::flush;
+			Map layer(cfg.bounds);
+			fillNoise(type, layer, layerGen, origin, layerOctave);
+			layers.push_back(std::move(layer));
 		}
-		std::cout << " -> All done!                       \n";
+
+		// Weight and sum the layers in octave order, as the generators do
+		Map map(cfg.bounds);
+		ForEachLine(cfg.bounds, [&](int x) {
+			double* line = writeLine(map, x);
+			for (int y = 0; y < cfg.bounds.Y; y++)
+			{
+				double total = 0;
+				for (int oct = 0; oct < cfg.octaves; oct++)
+				{
+					total += layers[oct][x][y] * octaves[oct].influence;
+				}
+				line[y] = total;
+			}
+		});
 
 		if (cfg.normalize) map.Interpolate(0, 1);
 
 		return map;
 	}
+
+	int OctaveCache::Layers() const
+	{
+		return (int)layers.size();
+	}
+
+	void OctaveCache::Clear()
+	{
+		layers.clear();
+	}
+
+	bool OctaveCache::matches(const NoiseConfig& cfg, VecInt origin) const
+	{
+		if (layers.empty()) return false;
+
+		if (cfg.seed != layerCfg.seed ||
+			cfg.bounds != layerCfg.bounds ||
+			cfg.boxSize != layerCfg.boxSize ||
+			origin != layerOrigin)
+		{
+			return false;
+		}
+
+		switch (type)
+		{
+		case NoiseType::Simplex:
+			return cfg.lNorm == layerCfg.lNorm && cfg.r == layerCfg.r && cfg.rMinus == layerCfg.rMinus;
+		case NoiseType::Perlin:
+			return cfg.octDecrease == layerCfg.octDecrease;
+		case NoiseType::Worley:
+			return cfg.lNorm == layerCfg.lNorm && cfg.nearest == layerCfg.nearest;
+		}
+
+		return false;
+	}
+
+	void GenerateBatch(NoiseType type, const NoiseConfig& cfg, const std::vector<int64_t>& seeds, const BatchFn& fn)
+	{
+		const int count = (int)seeds.size();
+		Progress progress(cfg.progress, "GenerateBatch", count);
+
+		auto band = [&](int begin, int end) {
+			// Scratch shared by every seed of this band. Maps report progress
+			// through the batch rather than on their own.
+			NoiseConfig seedCfg = cfg;
+			seedCfg.progress = nullptr;
+			Map map(cfg.bounds);
+
+			for (int i = begin; i < end && !progress.Stopped(); i++)
+			{
+				seedCfg.seed = seeds[i];
+				fillNoise(type, map, seedCfg, VecInt(0, 0), makeOctaves(seedCfg));
+				fn(i, seeds[i], map);
+				progress.Step();
+			}
+		};
+
+		// A thread per map needs enough maps to go around; otherwise each
+		// map's lines are spread over the threads instead
+		if ((unsigned)count < GetThreadCount())
+		{
+			band(0, count);
+		}
+		else
+		{
+			const long long work = (long long)cfg.bounds.Area() * std::max(cfg.octaves, 1);
+			ParallelFor(0, count, band, (int)std::min<long long>(work, std::numeric_limits<int>::max()));
+		}
+		progress.Finish();
+	}
+
+	Map Simplex(const NoiseConfig& cfg)
+	{
+		return Simplex(cfg, VecInt(0, 0));
+	}
+
+	Map Perlin(const NoiseConfig& cfg)
+	{
+		return Perlin(cfg, VecInt(0, 0));
+	}
+
+	Map Worley(const NoiseConfig& cfg)
+	{
+		return Worley(cfg, VecInt(0, 0));
+	}
+
+	Map WorleyPlex(const NoiseConfig& cfg, const Map& baseMap)
+	{
+		return WorleyPlex(cfg, baseMap, VecInt(0, 0));
+	}
+
+	// The pixels covered by a world-space region, rounded outwards
+	static NoiseConfig regionConfig(const NoiseConfig& cfg, const Rect& region)
+	{
+		NoiseConfig tile = cfg;
+		tile.bounds = region.Ceil().max - region.Floor().min;
+		return tile;
+	}
+
+	Map Simplex(const NoiseConfig& cfg, const Rect& region)
+	{
+		return Simplex(regionConfig(cfg, region), (VecInt)region.Floor().min);
+	}
+
+	Map Perlin(const NoiseConfig& cfg, const Rect& region)
+	{
+		return Perlin(regionConfig(cfg, region), (VecInt)region.Floor().min);
+	}
+
+	Map Worley(const NoiseConfig& cfg, const Rect& region)
+	{
+		return Worley(regionConfig(cfg, region), (VecInt)region.Floor().min);
+	}
 }
@@ -0,0 +1,255 @@
+#include <zarks/internal/parallel.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace zmath
+{
+
+namespace
+{
+	// Below this many elements, handing work to other threads costs more than it saves
+	constexpr long long MIN_PARALLEL_WORK = 1 << 15;
+	// Bands per thread; a few per thread smooths out uneven band costs
+	constexpr int BANDS_PER_THREAD = 4;
+
+	constexpr int NO_OVERRIDE = -1;
+
+	std::atomic<Exec> globalPolicy(Exec::Parallel);
+	thread_local int scopedPolicy = NO_OVERRIDE;
+	// Set while a thread is running bands of a parallel job, so nested calls run inline
+	thread_local bool inJob = false;
+
+	//             //
+	// Thread Pool //
+	//             //
+
+	// A fixed set of workers that all cooperate on one job at a time. The
+	// thread that submits a job works on it too, and returns once every task
+	// is finished and no worker still holds a reference to the job.
+	class ThreadPool
+	{
+	public:
+		ThreadPool(unsigned threads)
+		{
+			for (unsigned i = 1; i < threads; i++)
+			{
+				workers.emplace_back(&ThreadPool::workerLoop, this);
+			}
+		}
+
+		~ThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stop = true;
+			}
+			wake.notify_all();
+			for (std::thread& worker : workers) worker.join();
+		}
+
+		unsigned Size() const
+		{
+			return workers.size() + 1;
+		}
+
+		// Returns false, without running anything, if another job is in progress
+		bool TryRun(int tasks, const std::function<void(int)>& task)
+		{
+			std::unique_lock<std::mutex> runLock(runMutex, std::try_to_lock);
+			if (!runLock.owns_lock()) return false;
+
+			Job job(tasks, task);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				current = &job;
+				generation++;
+			}
+			wake.notify_all();
+
+			inJob = true;
+			work(job);
+			inJob = false;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				current = nullptr;
+				finished.wait(lock, [this] { return active == 0; });
+			}
+
+			if (job.error) std::rethrow_exception(job.error);
+			return true;
+		}
+
+	private:
+		struct Job {
+			Job(int tasks, const std::function<void(int)>& task)
+				: tasks(tasks)
+				, task(task)
+				, next(0)
+			{}
+
+			const int tasks;
+			const std::function<void(int)>& task;
+			std::atomic<int> next;
+			std::mutex errorMutex;
+			std::exception_ptr error;
+		};
+
+		std::vector<std::thread> workers;
+		std::mutex runMutex;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable finished;
+		Job* current = nullptr;
+		unsigned long long generation = 0;
+		int active = 0;
+		bool stop = false;
+
+		static void work(Job& job)
+		{
+			for (int i = job.next++; i < job.tasks; i = job.next++)
+			{
+				try
+				{
+					job.task(i);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(job.errorMutex);
+					if (!job.error) job.error = std::current_exception();
+				}
+			}
+		}
+
+		void workerLoop()
+		{
+			inJob = true;
+			unsigned long long seen = 0;
+
+			std::unique_lock<std::mutex> lock(mutex);
+			while (true)
+			{
+				wake.wait(lock, [&] { return stop || generation != seen; });
+				if (stop) return;
+
+				seen = generation;
+				Job* job = current;
+				if (!job) continue;
+
+				active++;
+				lock.unlock();
+				work(*job);
+				lock.lock();
+
+				if (--active == 0) finished.notify_all();
+			}
+		}
+	};
+
+	std::mutex poolMutex;
+	std::shared_ptr<ThreadPool> pool;
+	unsigned requestedThreads = 0;
+
+	unsigned resolveThreads(unsigned threads)
+	{
+		if (threads == 0) threads = std::thread::hardware_concurrency();
+		return std::max(1u, threads);
+	}
+
+	std::shared_ptr<ThreadPool> getPool()
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		if (!pool) pool = std::make_shared<ThreadPool>(resolveThreads(requestedThreads));
+		return pool;
+	}
+
+	Exec effectivePolicy()
+	{
+		return (scopedPolicy == NO_OVERRIDE) ? globalPolicy.load() : (Exec)scopedPolicy;
+	}
+}
+
+//        //
+// Policy //
+//        //
+
+void SetExec(Exec policy)
+{
+	globalPolicy = policy;
+}
+
+Exec GetExec()
+{
+	return globalPolicy;
+}
+
+ExecScope::ExecScope(Exec policy)
+	: previous(scopedPolicy)
+{
+	scopedPolicy = (int)policy;
+}
+
+ExecScope::~ExecScope()
+{
+	scopedPolicy = previous;
+}
+
+void SetThreadCount(unsigned threads)
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+	requestedThreads = threads;
+	// Jobs still running on the old pool keep it alive until they finish
+	pool.reset();
+}
+
+unsigned GetThreadCount()
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+	return pool ? pool->Size() : resolveThreads(requestedThreads);
+}
+
+//             //
+// ParallelFor //
+//             //
+
+void ParallelFor(int begin, int end, const std::function<void(int, int)>& band, int workPerIndex)
+{
+	const int count = end - begin;
+	if (count <= 0) return;
+
+	const bool worthIt = (long long)count * std::max(1, workPerIndex) >= MIN_PARALLEL_WORK;
+	if (count == 1 || !worthIt || inJob || effectivePolicy() == Exec::Serial)
+	{
+		band(begin, end);
+		return;
+	}
+
+	std::shared_ptr<ThreadPool> threads = getPool();
+	if (threads->Size() == 1)
+	{
+		band(begin, end);
+		return;
+	}
+
+	const int bands = std::min(count, (int)threads->Size() * BANDS_PER_THREAD);
+	const auto runBand = [&](int i) {
+		// Spread the remainder over the first bands so sizes differ by at most one
+		const int bandBegin = begin + (int)((long long)count * i / bands);
+		const int bandEnd = begin + (int)((long long)count * (i + 1) / bands);
+		band(bandBegin, bandEnd);
+	};
+
+	// Another thread is already using the pool; don't wait for it
+	if (!threads->TryRun(bands, runBand))
+	{
+		band(begin, end);
+	}
+}
+
+} // namespace zmath
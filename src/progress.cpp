@@ -0,0 +1,53 @@
+#include <zarks/internal/progress.h>
+
+#include <algorithm>
+#include <string>
+
+namespace zmath
+{
+
+Cancelled::Cancelled(const char* stage)
+	: std::runtime_error(std::string(stage) + " was cancelled")
+{}
+
+Progress::Progress(const ProgressFn& fn, const char* stage, size_t units)
+	: fn(fn)
+	, stage(stage)
+	, units(units)
+	, every(std::max<size_t>(1, units / 100))
+	, done(0)
+	, stopped(false)
+{
+	if (fn) report();
+}
+
+void Progress::Step()
+{
+	if (!fn) return;
+
+	const size_t at = ++done;
+	if (at % every == 0 || at == units) report();
+}
+
+bool Progress::Stopped() const
+{
+	return stopped.load(std::memory_order_relaxed);
+}
+
+void Progress::Finish() const
+{
+	if (Stopped()) throw Cancelled(stage);
+}
+
+void Progress::report()
+{
+	std::lock_guard<std::mutex> lock(reportMutex);
+	if (Stopped()) return;
+
+	// Read under the lock, so reported fractions never go backwards
+	const size_t at = done;
+	const double fraction = units ? std::min(1.0, (double)at / units) : 1.0;
+	if (!fn(stage, fraction)) stopped = true;
+}
+
+} // namespace zmath
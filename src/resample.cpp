@@ -0,0 +1,171 @@
+#include <zarks/internal/resample.h>
+#include <zarks/internal/parallel.h>
+#include <zarks/internal/simd.h>
+#include <zarks/internal/zmath_internals.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace zmath
+{
+namespace resample
+{
+
+namespace
+{
+	double sinc(double x)
+	{
+		if (x == 0) return 1;
+		x *= PI;
+		return std::sin(x) / x;
+	}
+
+	// Reach of each filter, in source pixels, before widening for shrinking
+	double support(Filter filter)
+	{
+		switch (filter)
+		{
+		case Filter::Bilinear: return 1;
+		case Filter::Bicubic:  return 2;
+		case Filter::Lanczos3: return 3;
+		default:               return 0.5;
+		}
+	}
+
+	double kernel(Filter filter, double x)
+	{
+		x = std::abs(x);
+		switch (filter)
+		{
+		case Filter::Bilinear:
+			return std::max(0.0, 1 - x);
+		case Filter::Bicubic:
+		{
+			constexpr double a = -0.5;
+			if (x < 1) return ((a + 2) * x - (a + 3)) * x * x + 1;
+			if (x < 2) return ((a * x - 5 * a) * x + 8 * a) * x - 4 * a;
+			return 0;
+		}
+		case Filter::Lanczos3:
+			return x < 3 ? sinc(x) * sinc(x / 3) : 0;
+		default:
+			return 0;
+		}
+	}
+}
+
+Weights MakeWeights(Filter filter, int srcLen, int dstLen)
+{
+	const double scale = (double)srcLen / dstLen;
+	const double widen = std::max(1.0, scale);
+
+	Weights w;
+	w.taps = filter == Filter::Nearest ? 1
+	       : filter == Filter::Area ? (int)std::ceil(scale) + 1
+	       : (int)std::ceil(2 * support(filter) * widen) + 1;
+	w.taps = std::min(w.taps, srcLen);
+	w.first.resize(dstLen);
+	w.count.resize(dstLen);
+	w.weights.assign((size_t)dstLen * w.taps, 0.0);
+
+	std::vector<double> raw;
+	for (int i = 0; i < dstLen; i++)
+	{
+		// Source pixels [lo, hi] reached by output i, and their raw weights
+		int lo, hi;
+		raw.clear();
+
+		if (filter == Filter::Nearest)
+		{
+			lo = hi = std::min(srcLen - 1, (int)(i * scale));
+			raw.push_back(1);
+		}
+		else if (filter == Filter::Area)
+		{
+			const double begin = i * scale, end = (i + 1) * scale;
+			lo = (int)std::floor(begin);
+			hi = std::max(lo, (int)std::ceil(end) - 1);
+			for (int j = lo; j <= hi; j++)
+			{
+				raw.push_back(std::max(0.0, std::min(end, j + 1.0) - std::max(begin, (double)j)));
+			}
+		}
+		else
+		{
+			// Pixel centres sit at half-integers in either grid
+			const double center = (i + 0.5) * scale - 0.5;
+			const double reach = support(filter) * widen;
+			lo = (int)std::ceil(center - reach);
+			hi = (int)std::floor(center + reach);
+			for (int j = lo; j <= hi; j++)
+			{
+				raw.push_back(kernel(filter, (j - center) / widen));
+			}
+		}
+
+		// Fold taps outside the source onto its edges
+		const int first = std::max(0, std::min(srcLen - 1, lo));
+		const int last = std::max(0, std::min(srcLen - 1, hi));
+		double* out = &w.weights[(size_t)i * w.taps];
+		double total = 0;
+		for (int j = lo; j <= hi; j++)
+		{
+			const int k = std::max(0, std::min(srcLen - 1, j)) - first;
+			out[k] += raw[j - lo];
+			total += raw[j - lo];
+		}
+		for (int k = 0; k <= last - first; k++) out[k] /= total;
+
+		w.first[i] = first;
+		w.count[i] = last - first + 1;
+	}
+
+	return w;
+}
+
+void Resample(Filter filter, const double* src, VecInt srcBounds, int srcStride,
+              double* dst, VecInt dstBounds, int dstStride, int channels)
+{
+	if (srcBounds.X <= 0 || srcBounds.Y <= 0 || dstBounds.X <= 0 || dstBounds.Y <= 0) return;
+
+	const Weights wy = MakeWeights(filter, srcBounds.Y, dstBounds.Y);
+	const Weights wx = MakeWeights(filter, srcBounds.X, dstBounds.X);
+
+	// Along x first: each intermediate line is a weighted sum of whole source
+	// lines, which vectorizes, and leaves only dstBounds.X lines for the y pass
+	const int srcLen = srcBounds.Y * channels;
+	std::vector<double> lines((size_t)dstBounds.X * srcLen);
+
+	ForEachLine(VecInt(dstBounds.X, srcBounds.Y), [&](int x) {
+		double* out = &lines[(size_t)x * srcLen];
+		const double* weights = &wx.weights[(size_t)x * wx.taps];
+
+		simd::Fill(out, srcLen, 0);
+		for (int k = 0; k < wx.count[x]; k++)
+		{
+			simd::AddScaled(out, src + (size_t)(wx.first[x] + k) * srcStride, srcLen, weights[k]);
+		}
+	});
+
+	// Then along y, within each line
+	ForEachLine(dstBounds, [&](int x) {
+		const double* in = &lines[(size_t)x * srcLen];
+		double* out = dst + (size_t)x * dstStride;
+
+		for (int y = 0; y < dstBounds.Y; y++)
+		{
+			const double* weights = &wy.weights[(size_t)y * wy.taps];
+			const double* from = in + (size_t)wy.first[y] * channels;
+
+			for (int c = 0; c < channels; c++)
+			{
+				double sum = 0;
+				for (int k = 0; k < wy.count[y]; k++) sum += weights[k] * from[k * channels + c];
+				out[y * channels + c] = sum;
+			}
+		}
+	});
+}
+
+} // namespace resample
+} // namespace zmath
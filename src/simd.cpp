@@ -0,0 +1,680 @@
+#include <zarks/internal/simd.h>
+#include <zarks/internal/simd_target.h>
+#include <zarks/internal/zmath_internals.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace zmath
+{
+namespace simd
+{
+
+//        //
+// SCALAR //
+//        //
+
+namespace scalar
+{
+	void Fill(double* dst, size_t n, double val)
+	{
+		for (size_t i = 0; i < n; i++) dst[i] = val;
+	}
+
+	void Replace(double* dst, size_t n, double val, double with)
+	{
+		for (size_t i = 0; i < n; i++) if (dst[i] == val) dst[i] = with;
+	}
+
+	void Add(double* dst, const double* src, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) dst[i] += src[i];
+	}
+
+	void Sub(double* dst, const double* src, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) dst[i] -= src[i];
+	}
+
+	void Mul(double* dst, const double* src, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) dst[i] *= src[i];
+	}
+
+	void Div(double* dst, const double* src, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			if (src[i] == 0)
+			{
+				if (dst[i] > 0) dst[i] = DOUBLEMAX;
+				else if (dst[i] < 0) dst[i] = DOUBLEMIN;
+			}
+			else
+			{
+				dst[i] /= src[i];
+			}
+		}
+	}
+
+	void Add(double* dst, size_t n, double val)
+	{
+		for (size_t i = 0; i < n; i++) dst[i] += val;
+	}
+
+	void Sub(double* dst, size_t n, double val)
+	{
+		for (size_t i = 0; i < n; i++) dst[i] -= val;
+	}
+
+	void Mul(double* dst, size_t n, double val)
+	{
+		for (size_t i = 0; i < n; i++) dst[i] *= val;
+	}
+
+	void Div(double* dst, size_t n, double val)
+	{
+		for (size_t i = 0; i < n; i++) dst[i] /= val;
+	}
+
+	void AddScaled(double* dst, const double* src, size_t n, double scale)
+	{
+		for (size_t i = 0; i < n; i++) dst[i] += src[i] * scale;
+	}
+
+	void Abs(double* dst, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) dst[i] = std::abs(dst[i]);
+	}
+
+	void Min(double* dst, size_t n, double max)
+	{
+		for (size_t i = 0; i < n; i++) dst[i] = std::min(max, dst[i]);
+	}
+
+	void Max(double* dst, size_t n, double min)
+	{
+		for (size_t i = 0; i < n; i++) dst[i] = std::max(min, dst[i]);
+	}
+
+	void Clamp(double* dst, size_t n, double min, double max)
+	{
+		for (size_t i = 0; i < n; i++) dst[i] = std::min(max, std::max(min, dst[i]));
+	}
+
+	// Lane-wise reduction state shared by every level, so that the vector
+	// paths can hand their lanes over for the scalar tail and final fold
+	struct Lanes {
+		double min[4], max[4], sum[4];
+
+		void Init(double first)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				min[j] = max[j] = first;
+				sum[j] = 0;
+			}
+		}
+
+		// Elements from 'start' onwards, where 'start' is a multiple of four
+		void Tail(const double* src, size_t start, size_t n)
+		{
+			for (size_t i = start; i < n; i++)
+			{
+				min[i - start] = std::min(min[i - start], src[i]);
+				max[i - start] = std::max(max[i - start], src[i]);
+				sum[i - start] += src[i];
+			}
+		}
+
+		void Fold(double& outMin, double& outMax, double& outSum) const
+		{
+			outMin = std::min(std::min(min[0], min[1]), std::min(min[2], min[3]));
+			outMax = std::max(std::max(max[0], max[1]), std::max(max[2], max[3]));
+			outSum = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+		}
+	};
+
+	void MinMaxSum(const double* src, size_t n, double& min, double& max, double& sum)
+	{
+		Lanes lanes;
+		lanes.Init(src[0]);
+
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				lanes.min[j] = std::min(lanes.min[j], src[i + j]);
+				lanes.max[j] = std::max(lanes.max[j], src[i + j]);
+				lanes.sum[j] += src[i + j];
+			}
+		}
+
+		lanes.Tail(src, i, n);
+		lanes.Fold(min, max, sum);
+	}
+
+	double SumSquaredDiffTail(const double* src, size_t start, size_t n, double mean, double* sum)
+	{
+		for (size_t i = start; i < n; i++)
+		{
+			const double diff = src[i] - mean;
+			sum[i - start] += diff * diff;
+		}
+		return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+	}
+
+	double SumSquaredDiff(const double* src, size_t n, double mean)
+	{
+		double sum[4] = { 0, 0, 0, 0 };
+
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				const double diff = src[i + j] - mean;
+				sum[j] += diff * diff;
+			}
+		}
+
+		return SumSquaredDiffTail(src, i, n, mean, sum);
+	}
+} // namespace scalar
+
+#ifdef ZMATH_SIMD_X86
+
+//      //
+// SSE2 //
+//      //
+
+// Each vector loop hands its leftover tail to the scalar kernel of the same name
+namespace sse2
+{
+	void Fill(double* dst, size_t n, double val)
+	{
+		const __m128d v = _mm_set1_pd(val);
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2) _mm_storeu_pd(dst + i, v);
+		scalar::Fill(dst + i, n - i, val);
+	}
+
+	void Replace(double* dst, size_t n, double val, double with)
+	{
+		const __m128d v = _mm_set1_pd(val);
+		const __m128d w = _mm_set1_pd(with);
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2)
+		{
+			__m128d d = _mm_loadu_pd(dst + i);
+			__m128d eq = _mm_cmpeq_pd(d, v);
+			_mm_storeu_pd(dst + i, _mm_or_pd(_mm_and_pd(eq, w), _mm_andnot_pd(eq, d)));
+		}
+		scalar::Replace(dst + i, n - i, val, with);
+	}
+
+	#define ZMATH_SSE2_BINARY(name, op) \
+	void name(double* dst, const double* src, size_t n) \
+	{ \
+		size_t i = 0; \
+		for (; i + 2 <= n; i += 2) \
+			_mm_storeu_pd(dst + i, op(_mm_loadu_pd(dst + i), _mm_loadu_pd(src + i))); \
+		scalar::name(dst + i, src + i, n - i); \
+	} \
+	void name(double* dst, size_t n, double val) \
+	{ \
+		const __m128d v = _mm_set1_pd(val); \
+		size_t i = 0; \
+		for (; i + 2 <= n; i += 2) \
+			_mm_storeu_pd(dst + i, op(_mm_loadu_pd(dst + i), v)); \
+		scalar::name(dst + i, n - i, val); \
+	}
+
+	ZMATH_SSE2_BINARY(Add, _mm_add_pd)
+	ZMATH_SSE2_BINARY(Sub, _mm_sub_pd)
+	ZMATH_SSE2_BINARY(Mul, _mm_mul_pd)
+
+	#undef ZMATH_SSE2_BINARY
+
+	void AddScaled(double* dst, const double* src, size_t n, double scale)
+	{
+		const __m128d v = _mm_set1_pd(scale);
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2)
+			_mm_storeu_pd(dst + i, _mm_add_pd(_mm_loadu_pd(dst + i), _mm_mul_pd(_mm_loadu_pd(src + i), v)));
+		scalar::AddScaled(dst + i, src + i, n - i, scale);
+	}
+
+	void Div(double* dst, const double* src, size_t n)
+	{
+		const __m128d zero = _mm_setzero_pd();
+		const __m128d hi = _mm_set1_pd(DOUBLEMAX);
+		const __m128d lo = _mm_set1_pd(DOUBLEMIN);
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2)
+		{
+			__m128d d = _mm_loadu_pd(dst + i);
+			__m128d s = _mm_loadu_pd(src + i);
+			__m128d byZero = _mm_cmpeq_pd(s, zero);
+			__m128d pos = _mm_cmpgt_pd(d, zero);
+			__m128d neg = _mm_cmplt_pd(d, zero);
+			// Value to use where dividing by zero: saturate by sign, or keep as-is
+			__m128d sat = _mm_or_pd(
+				_mm_or_pd(_mm_and_pd(pos, hi), _mm_and_pd(neg, lo)),
+				_mm_andnot_pd(_mm_or_pd(pos, neg), d));
+			__m128d q = _mm_div_pd(d, s);
+			_mm_storeu_pd(dst + i, _mm_or_pd(_mm_and_pd(byZero, sat), _mm_andnot_pd(byZero, q)));
+		}
+		scalar::Div(dst + i, src + i, n - i);
+	}
+
+	void Div(double* dst, size_t n, double val)
+	{
+		const __m128d v = _mm_set1_pd(val);
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2) _mm_storeu_pd(dst + i, _mm_div_pd(_mm_loadu_pd(dst + i), v));
+		scalar::Div(dst + i, n - i, val);
+	}
+
+	void Abs(double* dst, size_t n)
+	{
+		const __m128d sign = _mm_set1_pd(-0.0);
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2) _mm_storeu_pd(dst + i, _mm_andnot_pd(sign, _mm_loadu_pd(dst + i)));
+		scalar::Abs(dst + i, n - i);
+	}
+
+	// _mm_min_pd(a, b) is (a < b ? a : b), which is exactly std::min(b, a)
+	void Min(double* dst, size_t n, double max)
+	{
+		const __m128d v = _mm_set1_pd(max);
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2) _mm_storeu_pd(dst + i, _mm_min_pd(_mm_loadu_pd(dst + i), v));
+		scalar::Min(dst + i, n - i, max);
+	}
+
+	void Max(double* dst, size_t n, double min)
+	{
+		const __m128d v = _mm_set1_pd(min);
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2) _mm_storeu_pd(dst + i, _mm_max_pd(_mm_loadu_pd(dst + i), v));
+		scalar::Max(dst + i, n - i, min);
+	}
+
+	void Clamp(double* dst, size_t n, double min, double max)
+	{
+		const __m128d vMin = _mm_set1_pd(min);
+		const __m128d vMax = _mm_set1_pd(max);
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2)
+			_mm_storeu_pd(dst + i, _mm_min_pd(_mm_max_pd(_mm_loadu_pd(dst + i), vMin), vMax));
+		scalar::Clamp(dst + i, n - i, min, max);
+	}
+
+	// Lanes 0-1 live in the 'lo' registers and lanes 2-3 in the 'hi' ones.
+	// Note _mm_min_pd(v, acc) is (v < acc ? v : acc), i.e. std::min(acc, v).
+	void MinMaxSum(const double* src, size_t n, double& min, double& max, double& sum)
+	{
+		__m128d minLo = _mm_set1_pd(src[0]), minHi = minLo;
+		__m128d maxLo = minLo, maxHi = minLo;
+		__m128d sumLo = _mm_setzero_pd(), sumHi = sumLo;
+
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			const __m128d lo = _mm_loadu_pd(src + i);
+			const __m128d hi = _mm_loadu_pd(src + i + 2);
+			minLo = _mm_min_pd(lo, minLo);
+			minHi = _mm_min_pd(hi, minHi);
+			maxLo = _mm_max_pd(lo, maxLo);
+			maxHi = _mm_max_pd(hi, maxHi);
+			sumLo = _mm_add_pd(sumLo, lo);
+			sumHi = _mm_add_pd(sumHi, hi);
+		}
+
+		scalar::Lanes lanes;
+		_mm_storeu_pd(lanes.min, minLo);
+		_mm_storeu_pd(lanes.min + 2, minHi);
+		_mm_storeu_pd(lanes.max, maxLo);
+		_mm_storeu_pd(lanes.max + 2, maxHi);
+		_mm_storeu_pd(lanes.sum, sumLo);
+		_mm_storeu_pd(lanes.sum + 2, sumHi);
+		lanes.Tail(src, i, n);
+		lanes.Fold(min, max, sum);
+	}
+
+	double SumSquaredDiff(const double* src, size_t n, double mean)
+	{
+		const __m128d m = _mm_set1_pd(mean);
+		__m128d sumLo = _mm_setzero_pd(), sumHi = sumLo;
+
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			const __m128d lo = _mm_sub_pd(_mm_loadu_pd(src + i), m);
+			const __m128d hi = _mm_sub_pd(_mm_loadu_pd(src + i + 2), m);
+			sumLo = _mm_add_pd(sumLo, _mm_mul_pd(lo, lo));
+			sumHi = _mm_add_pd(sumHi, _mm_mul_pd(hi, hi));
+		}
+
+		double sum[4];
+		_mm_storeu_pd(sum, sumLo);
+		_mm_storeu_pd(sum + 2, sumHi);
+		return scalar::SumSquaredDiffTail(src, i, n, mean, sum);
+	}
+} // namespace sse2
+
+//      //
+// AVX2 //
+//      //
+
+namespace avx2
+{
+	ZMATH_TARGET_AVX2 void Fill(double* dst, size_t n, double val)
+	{
+		const __m256d v = _mm256_set1_pd(val);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) _mm256_storeu_pd(dst + i, v);
+		scalar::Fill(dst + i, n - i, val);
+	}
+
+	ZMATH_TARGET_AVX2 void Replace(double* dst, size_t n, double val, double with)
+	{
+		const __m256d v = _mm256_set1_pd(val);
+		const __m256d w = _mm256_set1_pd(with);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m256d d = _mm256_loadu_pd(dst + i);
+			_mm256_storeu_pd(dst + i, _mm256_blendv_pd(d, w, _mm256_cmp_pd(d, v, _CMP_EQ_OQ)));
+		}
+		scalar::Replace(dst + i, n - i, val, with);
+	}
+
+	#define ZMATH_AVX2_BINARY(name, op) \
+	ZMATH_TARGET_AVX2 void name(double* dst, const double* src, size_t n) \
+	{ \
+		size_t i = 0; \
+		for (; i + 4 <= n; i += 4) \
+			_mm256_storeu_pd(dst + i, op(_mm256_loadu_pd(dst + i), _mm256_loadu_pd(src + i))); \
+		scalar::name(dst + i, src + i, n - i); \
+	} \
+	ZMATH_TARGET_AVX2 void name(double* dst, size_t n, double val) \
+	{ \
+		const __m256d v = _mm256_set1_pd(val); \
+		size_t i = 0; \
+		for (; i + 4 <= n; i += 4) \
+			_mm256_storeu_pd(dst + i, op(_mm256_loadu_pd(dst + i), v)); \
+		scalar::name(dst + i, n - i, val); \
+	}
+
+	ZMATH_AVX2_BINARY(Add, _mm256_add_pd)
+	ZMATH_AVX2_BINARY(Sub, _mm256_sub_pd)
+	ZMATH_AVX2_BINARY(Mul, _mm256_mul_pd)
+
+	#undef ZMATH_AVX2_BINARY
+
+	// Multiply then add, never fused, to stay bit-identical to the other levels
+	ZMATH_TARGET_AVX2 void AddScaled(double* dst, const double* src, size_t n, double scale)
+	{
+		const __m256d v = _mm256_set1_pd(scale);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm256_storeu_pd(dst + i, _mm256_add_pd(_mm256_loadu_pd(dst + i), _mm256_mul_pd(_mm256_loadu_pd(src + i), v)));
+		scalar::AddScaled(dst + i, src + i, n - i, scale);
+	}
+
+	ZMATH_TARGET_AVX2 void Div(double* dst, const double* src, size_t n)
+	{
+		const __m256d zero = _mm256_setzero_pd();
+		const __m256d hi = _mm256_set1_pd(DOUBLEMAX);
+		const __m256d lo = _mm256_set1_pd(DOUBLEMIN);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m256d d = _mm256_loadu_pd(dst + i);
+			__m256d s = _mm256_loadu_pd(src + i);
+			__m256d byZero = _mm256_cmp_pd(s, zero, _CMP_EQ_OQ);
+			__m256d sat = _mm256_blendv_pd(d, hi, _mm256_cmp_pd(d, zero, _CMP_GT_OQ));
+			sat = _mm256_blendv_pd(sat, lo, _mm256_cmp_pd(d, zero, _CMP_LT_OQ));
+			_mm256_storeu_pd(dst + i, _mm256_blendv_pd(_mm256_div_pd(d, s), sat, byZero));
+		}
+		scalar::Div(dst + i, src + i, n - i);
+	}
+
+	ZMATH_TARGET_AVX2 void Div(double* dst, size_t n, double val)
+	{
+		const __m256d v = _mm256_set1_pd(val);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) _mm256_storeu_pd(dst + i, _mm256_div_pd(_mm256_loadu_pd(dst + i), v));
+		scalar::Div(dst + i, n - i, val);
+	}
+
+	ZMATH_TARGET_AVX2 void Abs(double* dst, size_t n)
+	{
+		const __m256d sign = _mm256_set1_pd(-0.0);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) _mm256_storeu_pd(dst + i, _mm256_andnot_pd(sign, _mm256_loadu_pd(dst + i)));
+		scalar::Abs(dst + i, n - i);
+	}
+
+	ZMATH_TARGET_AVX2 void Min(double* dst, size_t n, double max)
+	{
+		const __m256d v = _mm256_set1_pd(max);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) _mm256_storeu_pd(dst + i, _mm256_min_pd(_mm256_loadu_pd(dst + i), v));
+		scalar::Min(dst + i, n - i, max);
+	}
+
+	ZMATH_TARGET_AVX2 void Max(double* dst, size_t n, double min)
+	{
+		const __m256d v = _mm256_set1_pd(min);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) _mm256_storeu_pd(dst + i, _mm256_max_pd(_mm256_loadu_pd(dst + i), v));
+		scalar::Max(dst + i, n - i, min);
+	}
+
+	ZMATH_TARGET_AVX2 void Clamp(double* dst, size_t n, double min, double max)
+	{
+		const __m256d vMin = _mm256_set1_pd(min);
+		const __m256d vMax = _mm256_set1_pd(max);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm256_storeu_pd(dst + i, _mm256_min_pd(_mm256_max_pd(_mm256_loadu_pd(dst + i), vMin), vMax));
+		scalar::Clamp(dst + i, n - i, min, max);
+	}
+
+	ZMATH_TARGET_AVX2 void MinMaxSum(const double* src, size_t n, double& min, double& max, double& sum)
+	{
+		__m256d vMin = _mm256_set1_pd(src[0]);
+		__m256d vMax = vMin;
+		__m256d vSum = _mm256_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			const __m256d v = _mm256_loadu_pd(src + i);
+			vMin = _mm256_min_pd(v, vMin);
+			vMax = _mm256_max_pd(v, vMax);
+			vSum = _mm256_add_pd(vSum, v);
+		}
+
+		scalar::Lanes lanes;
+		_mm256_storeu_pd(lanes.min, vMin);
+		_mm256_storeu_pd(lanes.max, vMax);
+		_mm256_storeu_pd(lanes.sum, vSum);
+		lanes.Tail(src, i, n);
+		lanes.Fold(min, max, sum);
+	}
+
+	ZMATH_TARGET_AVX2 double SumSquaredDiff(const double* src, size_t n, double mean)
+	{
+		const __m256d m = _mm256_set1_pd(mean);
+		__m256d vSum = _mm256_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			const __m256d d = _mm256_sub_pd(_mm256_loadu_pd(src + i), m);
+			// No FMA here: the scalar path rounds the product separately
+			vSum = _mm256_add_pd(vSum, _mm256_mul_pd(d, d));
+		}
+
+		double sum[4];
+		_mm256_storeu_pd(sum, vSum);
+		return scalar::SumSquaredDiffTail(src, i, n, mean, sum);
+	}
+} // namespace avx2
+
+#endif // ZMATH_SIMD_X86
+
+//          //
+// DISPATCH //
+//          //
+
+namespace
+{
+	std::atomic<Level>& activeLevel()
+	{
+		static std::atomic<Level> level(DetectLevel());
+		return level;
+	}
+}
+
+Level DetectLevel()
+{
+#ifdef ZMATH_SIMD_X86
+	#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuidex(info, 7, 0);
+		const bool hasAVX2 = (info[1] & (1 << 5)) != 0;
+		__cpuid(info, 1);
+		const bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+		// The OS must also save the upper halves of the YMM registers
+		if (hasAVX2 && hasOSXSAVE && (_xgetbv(0) & 0x6) == 0x6) return Level::AVX2;
+	#else
+		if (__builtin_cpu_supports("avx2")) return Level::AVX2;
+	#endif
+	// SSE2 is part of the x86-64 baseline
+	return Level::SSE2;
+#else
+	return Level::Scalar;
+#endif
+}
+
+Level ActiveLevel()
+{
+	return activeLevel().load(std::memory_order_relaxed);
+}
+
+void SetLevel(Level level)
+{
+	activeLevel().store(std::min(level, DetectLevel()), std::memory_order_relaxed);
+}
+
+void Fill(double* dst, size_t n, double val)
+{
+	ZMATH_DISPATCH(avx2::Fill, sse2::Fill, scalar::Fill, dst, n, val)
+}
+
+void Replace(double* dst, size_t n, double val, double with)
+{
+	ZMATH_DISPATCH(avx2::Replace, sse2::Replace, scalar::Replace, dst, n, val, with)
+}
+
+void Add(double* dst, const double* src, size_t n)
+{
+	ZMATH_DISPATCH(avx2::Add, sse2::Add, scalar::Add, dst, src, n)
+}
+
+void Sub(double* dst, const double* src, size_t n)
+{
+	ZMATH_DISPATCH(avx2::Sub, sse2::Sub, scalar::Sub, dst, src, n)
+}
+
+void Mul(double* dst, const double* src, size_t n)
+{
+	ZMATH_DISPATCH(avx2::Mul, sse2::Mul, scalar::Mul, dst, src, n)
+}
+
+void Div(double* dst, const double* src, size_t n)
+{
+	ZMATH_DISPATCH(avx2::Div, sse2::Div, scalar::Div, dst, src, n)
+}
+
+void Add(double* dst, size_t n, double val)
+{
+	ZMATH_DISPATCH(avx2::Add, sse2::Add, scalar::Add, dst, n, val)
+}
+
+void Sub(double* dst, size_t n, double val)
+{
+	ZMATH_DISPATCH(avx2::Sub, sse2::Sub, scalar::Sub, dst, n, val)
+}
+
+void Mul(double* dst, size_t n, double val)
+{
+	ZMATH_DISPATCH(avx2::Mul, sse2::Mul, scalar::Mul, dst, n, val)
+}
+
+void Div(double* dst, size_t n, double val)
+{
+	ZMATH_DISPATCH(avx2::Div, sse2::Div, scalar::Div, dst, n, val)
+}
+
+void AddScaled(double* dst, const double* src, size_t n, double scale)
+{
+	ZMATH_DISPATCH(avx2::AddScaled, sse2::AddScaled, scalar::AddScaled, dst, src, n, scale)
+}
+
+void Abs(double* dst, size_t n)
+{
+	ZMATH_DISPATCH(avx2::Abs, sse2::Abs, scalar::Abs, dst, n)
+}
+
+void Min(double* dst, size_t n, double max)
+{
+	ZMATH_DISPATCH(avx2::Min, sse2::Min, scalar::Min, dst, n, max)
+}
+
+void Max(double* dst, size_t n, double min)
+{
+	ZMATH_DISPATCH(avx2::Max, sse2::Max, scalar::Max, dst, n, min)
+}
+
+void Clamp(double* dst, size_t n, double min, double max)
+{
+	ZMATH_DISPATCH(avx2::Clamp, sse2::Clamp, scalar::Clamp, dst, n, min, max)
+}
+
+void MinMaxSum(const double* src, size_t n, double& min, double& max, double& sum)
+{
+	ZMATH_DISPATCH(avx2::MinMaxSum, sse2::MinMaxSum, scalar::MinMaxSum, src, n, min, max, sum)
+}
+
+double SumSquaredDiff(const double* src, size_t n, double mean)
+{
+	double result = 0;
+	ZMATH_DISPATCH(result = avx2::SumSquaredDiff, result = sse2::SumSquaredDiff, result = scalar::SumSquaredDiff, src, n, mean)
+	return result;
+}
+
+
+void Pow(double* dst, size_t n, double exp)
+{
+	// There is no vector pow instruction, so only the exponents that reduce
+	// to plain arithmetic get a vector path
+	if (exp == 1) return;
+	if (exp == 2)
+	{
+		Mul(dst, dst, n);
+		return;
+	}
+
+	for (size_t i = 0; i < n; i++) dst[i] = std::pow(dst[i], exp);
+}
+
+} // namespace simd
+} // namespace zmath
@@ -1,10 +1,1033 @@
 #include <zarks/math/Map.h>
+#include <zarks/internal/simd.h>
+#include <zarks/math/MapExpr.h>
+#include <zarks/noise/noise2D.h>
+#include <zarks/internal/parallel.h>
+#include <zarks/noise/Noiser.h>
+#include <zarks/math/MapT.h>
+#include <zarks/internal/noise_internals.h>
+#include <zarks/image/Image.h>
+#include <zarks/math/SummedArea.h>
+#include <zarks/math/Filter.h>
+#include <stb/stb_image.h>
+#include <stb/stb_image_write.h>
+#include <zarks/image/PaletteIndex.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
 
 using namespace zmath;
 
+namespace
+{
+	int failures = 0;
+
+	void check(bool ok, const std::string& what)
+	{
+		if (!ok)
+		{
+			std::cerr << "FAILED: " << what << "\n";
+			failures++;
+		}
+	}
+
+	bool near(double a, double b, double tolerance)
+	{
+		return std::abs(a - b) <= tolerance * std::max(1.0, std::max(std::abs(a), std::abs(b)));
+	}
+
+	// Deterministic values with some spread, from a simple LCG
+	Map testMap(VecInt bounds, unsigned seed)
+	{
+		Map map(bounds);
+		for (int x = 0; x < bounds.X; x++)
+		{
+			for (int y = 0; y < bounds.Y; y++)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				map.Set(x, y, (seed >> 8) / double(1 << 24) * 20 - 7);
+			}
+		}
+		return map;
+	}
+
+	bool identical(const Map& a, const Map& b)
+	{
+		if (a.Bounds() != b.Bounds()) return false;
+		for (int x = 0; x < a.Bounds().X; x++)
+		{
+			for (int y = 0; y < a.Bounds().Y; y++)
+			{
+				if (a[x][y] != b[x][y]) return false;
+			}
+		}
+		return true;
+	}
+
+	// An odd length, to reach the tail of every vector loop, holding the
+	// values the kernels are most likely to disagree on
+	std::vector<double> simdInput(unsigned seed)
+	{
+		const double inf = std::numeric_limits<double>::infinity();
+		std::vector<double> values = {
+			std::numeric_limits<double>::quiet_NaN(), 0.0, -0.0, inf, -inf,
+			std::numeric_limits<double>::denorm_min(), -std::numeric_limits<double>::max(), 2.5, -2.5,
+		};
+		while (values.size() < 37)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			values.push_back((seed >> 8) / double(1 << 24) * 20 - 7);
+		}
+		return values;
+	}
+
+	// Runs 'op' on a copy of 'input' at each level this CPU allows, and
+	// compares every result with the scalar one bit for bit
+	template <typename Op>
+	void checkLevels(const std::vector<double>& input, const std::string& what, Op op)
+	{
+		const simd::Level active = simd::ActiveLevel();
+
+		simd::SetLevel(simd::Level::Scalar);
+		std::vector<double> want = input;
+		op(want);
+
+		for (int level = (int)simd::Level::SSE2; level <= (int)simd::DetectLevel(); level++)
+		{
+			simd::SetLevel((simd::Level)level);
+			std::vector<double> got = input;
+			op(got);
+			const bool same = got.size() == want.size()
+				&& std::memcmp(got.data(), want.data(), got.size() * sizeof(double)) == 0;
+			check(same, "simd " + what + " at level " + std::to_string(level));
+		}
+
+		simd::SetLevel(active);
+	}
+
+	// Every elementwise kernel at every level against the scalar path
+	void testSimd()
+	{
+		const std::vector<double> a = simdInput(9);
+		// The same special values, lined up against different ones in 'a'
+		std::vector<double> b = simdInput(10);
+		std::rotate(b.begin(), b.begin() + 3, b.end());
+		b[20] = 0.0;
+		b[21] = -0.0;
+		const size_t n = a.size();
+
+		checkLevels(a, "Add", [&](std::vector<double>& v) { simd::Add(v.data(), b.data(), n); });
+		checkLevels(a, "Sub", [&](std::vector<double>& v) { simd::Sub(v.data(), b.data(), n); });
+		checkLevels(a, "Mul", [&](std::vector<double>& v) { simd::Mul(v.data(), b.data(), n); });
+		checkLevels(a, "Div", [&](std::vector<double>& v) { simd::Div(v.data(), b.data(), n); });
+		checkLevels(a, "Abs", [&](std::vector<double>& v) { simd::Abs(v.data(), n); });
+		checkLevels(a, "Fill", [&](std::vector<double>& v) { simd::Fill(v.data(), n, -0.0); });
+		checkLevels(a, "Replace", [&](std::vector<double>& v) { simd::Replace(v.data(), n, 2.5, -1); });
+		checkLevels(a, "Replace of zero", [&](std::vector<double>& v) { simd::Replace(v.data(), n, 0.0, 7); });
+
+		for (double val : b)
+		{
+			const std::string with = " with " + std::to_string(val);
+			checkLevels(a, "Add" + with, [&](std::vector<double>& v) { simd::Add(v.data(), n, val); });
+			checkLevels(a, "Sub" + with, [&](std::vector<double>& v) { simd::Sub(v.data(), n, val); });
+			checkLevels(a, "Mul" + with, [&](std::vector<double>& v) { simd::Mul(v.data(), n, val); });
+			checkLevels(a, "Div" + with, [&](std::vector<double>& v) { simd::Div(v.data(), n, val); });
+			checkLevels(a, "Min" + with, [&](std::vector<double>& v) { simd::Min(v.data(), n, val); });
+			checkLevels(a, "Max" + with, [&](std::vector<double>& v) { simd::Max(v.data(), n, val); });
+			checkLevels(a, "Clamp" + with, [&](std::vector<double>& v) { simd::Clamp(v.data(), n, val, val + 1); });
+		}
+
+		const double exps[] = { 0.0, 1.0, 2.0, 0.5, -1.5, 3.0 };
+		for (double exp : exps)
+		{
+			checkLevels(a, "Pow with " + std::to_string(exp), [&](std::vector<double>& v) { simd::Pow(v.data(), n, exp); });
+		}
+	}
+
+	// The reductions at every level against the scalar path, over every
+	// length up to the input's so that each tail size is reached
+	void testSimdReductions()
+	{
+		const std::vector<double> special = simdInput(11);
+		std::vector<double> plain(special.begin() + 9, special.end());
+
+		const std::vector<double>* inputs[] = { &special, &plain };
+		for (const std::vector<double>* input : inputs)
+		{
+			for (size_t n = 1; n <= input->size(); n++)
+			{
+				const std::string what = " of " + std::to_string(n) + (input == &special ? " special values" : " values");
+				checkLevels(*input, "MinMaxSum" + what, [&](std::vector<double>& v) {
+					double min, max, sum;
+					simd::MinMaxSum(v.data(), n, min, max, sum);
+					v = { min, max, sum };
+				});
+				checkLevels(*input, "SumSquaredDiff" + what, [&](std::vector<double>& v) {
+					v = { simd::SumSquaredDiff(v.data(), n, 1.25) };
+				});
+			}
+		}
+	}
+
+	// Lazy chains against the same chains run eagerly, bit for bit
+	void testLazy()
+	{
+		const Map source = testMap(VecInt(29, 41), 12);
+		Map other = testMap(VecInt(29, 41), 13);
+		// Zero divisors, which saturate in both forms
+		other.Set(0, 0, 0);
+		other.Set(3, 7, 0);
+
+		Map eager = source;
+		eager.Abs().BoundMin(0.25).Mul(other).Pow(0.55).Add(1.5).Div(other).Sub(source).Bound(-20, 20).Div(0);
+		Map lazy(source.Bounds());
+		lazy = Lazy(source).Abs().BoundMin(0.25).Mul(other).Pow(0.55).Add(1.5).Div(other).Sub(source).Bound(-20, 20).Div(0);
+		check(identical(lazy, eager), "lazy chain against eager");
+
+		// Interpolate evaluates what comes before it, then carries on lazily
+		eager = source;
+		eager.Mul(-3).Add(other).Interpolate(-1, 1).BoundMax(0.5).Mul(2);
+		lazy = Lazy(source).Mul(-3).Add(other).Interpolate(-1, 1).BoundMax(0.5).Mul(2);
+		check(identical(lazy, eager), "lazy chain through Interpolate against eager");
+
+		// Evaluated into a new map, and from an owned temporary
+		const Map owned = Lazy(Map(source)).Sub(0.5).Abs();
+		eager = source;
+		eager.Sub(0.5).Abs();
+		check(identical(owned, eager), "lazy chain on a temporary against eager");
+	}
+
+	// Map::Stats() against a plain two-pass computation
+	void checkStats(const Map& map, const std::string& what)
+	{
+		const VecInt bounds = map.Bounds();
+		const double n = bounds.Area();
+
+		double min = map[0][0], max = map[0][0], sum = 0;
+		for (int x = 0; x < bounds.X; x++)
+		{
+			for (int y = 0; y < bounds.Y; y++)
+			{
+				min = std::min(min, map[x][y]);
+				max = std::max(max, map[x][y]);
+				sum += map[x][y];
+			}
+		}
+
+		const double mean = sum / n;
+		double m2 = 0;
+		for (int x = 0; x < bounds.X; x++)
+		{
+			for (int y = 0; y < bounds.Y; y++)
+			{
+				m2 += (map[x][y] - mean) * (map[x][y] - mean);
+			}
+		}
+
+		const MapStats stats = map.Stats();
+		check(stats.min == min, what + ": min");
+		check(stats.max == max, what + ": max");
+		check(near(stats.sum, sum, 1e-12), what + ": sum");
+		check(near(stats.mean, mean, 1e-12), what + ": mean");
+		check(near(stats.variance, m2 / (n - 1), 1e-12), what + ": variance");
+		check(near(stats.stdDev, std::sqrt(m2 / (n - 1)), 1e-12), what + ": standard deviation");
+	}
+
+	void testStats()
+	{
+		Map map = testMap(VecInt(37, 53), 1);
+		checkStats(map, "stats");
+		checkStats(map, "stats, cached");
+
+		map.Set(3, 4, 1000);
+		checkStats(map, "stats after Set()");
+		map.At(5, 6) = -1000;
+		checkStats(map, "stats after At()");
+		map *= 0.5;
+		checkStats(map, "stats after *=");
+		map.Clear(2);
+		checkStats(map, "stats after Clear()");
+
+		// Submaps see through to their parent
+		Map parent = testMap(VecInt(16, 16), 2);
+		Map sub = parent(VecInt(2, 2), VecInt(10, 10));
+		checkStats(sub, "submap stats");
+		parent.Set(4, 4, 500);
+		checkStats(sub, "submap stats after a parent write");
+		checkStats(parent, "parent stats after a submap");
+	}
+
+	// Writes through a pointer handed out before the stats were cached
+	void testStatsHeldPointer()
+	{
+		Map held(4, 4);
+		held.Clear(1);
+		double* line = held[0];
+		check(held.GetMax() == 1, "stats before a held write");
+		line[0] = 100;
+		check(held.GetMax() == 100, "stats after a held write");
+		line[1] = -100;
+		check(held.GetMin() == -100, "stats after a second held write");
+	}
+
+	// Writes through a reference from At() held across Stats()
+	void testStatsHeldReference()
+	{
+		Map held(4, 4);
+		held.Clear(1);
+		double& r = held.At(0, 0);
+		check(held.GetMax() == 1, "stats before a write through At()");
+		r = 5;
+		check(held.GetMax() == 5, "stats after a write through a held At() reference");
+		check(held.Stats().sum == 20, "sum after a write through a held At() reference");
+	}
+
+	// The generators give the same maps serially and in parallel
+	void testNoiseExec()
+	{
+		NoiseConfig cfg;
+		cfg.bounds = VecInt(61, 47);
+		cfg.boxSize = Vec(13.5, 13.5);
+		cfg.octaves = 3;
+		cfg.seed = 99;
+
+		auto generate = [&](Exec policy) {
+			ExecScope scope(policy);
+			std::vector<Map> maps;
+			maps.push_back(Simplex(cfg));
+			maps.push_back(Perlin(cfg));
+			maps.push_back(Worley(cfg));
+			return maps;
+		};
+		const std::vector<Map> serial = generate(Exec::Serial);
+		const std::vector<Map> parallel = generate(Exec::Parallel);
+		for (size_t i = 0; i < serial.size(); i++) check(identical(serial[i], parallel[i]), "noise " + std::to_string(i) + ", serial against parallel");
+	}
+
+	// What a Noiser should produce: every octave added in turn, one pixel
+	// at a time, on a single thread
+	Map serialNoise(NoisePointFunc func, VecInt bounds, int octaves, uint64_t seed)
+	{
+		Map reference(bounds);
+		NoiseHash hash(seed);
+		for (int oct = 0; oct < octaves; oct++)
+		{
+			hash.Clear();
+			const double octPow = std::pow(2, oct);
+			const Vec scale = Vec(octPow, octPow) / Vec(bounds);
+			for (int x = 0; x < bounds.X; x++)
+			{
+				for (int y = 0; y < bounds.Y; y++)
+				{
+					reference.At(x, y) += 1.0 / octPow * func(Vec(x, y) * scale, hash);
+				}
+			}
+		}
+		return reference;
+	}
+
+	// Batched noise against the single-point functions, whichever
+	// instruction set and thread count produce it
+	void testNoiser()
+	{
+		// Odd counts, for the tails
+		const NoiseHash pointHash(12345);
+		NoiseHash scalarHash = pointHash;
+		std::vector<double> xs, ys;
+		for (int i = 0; i < 37; i++)
+		{
+			xs.push_back(i * 0.731 - 9.2);
+			ys.push_back(i * -0.417 + 3.9);
+		}
+		std::vector<double> simplex(xs.size()), perlin(xs.size());
+		SimplexPoints(xs.data(), ys.data(), simplex.data(), xs.size(), pointHash);
+		PerlinPoints(xs.data(), ys.data(), perlin.data(), xs.size(), pointHash);
+
+		int wrong = 0;
+		for (size_t i = 0; i < xs.size(); i++)
+		{
+			if (simplex[i] != SimplexPoint(Vec(xs[i], ys[i]), scalarHash)) wrong++;
+			if (perlin[i] != PerlinPoint(Vec(xs[i], ys[i]), scalarHash)) wrong++;
+		}
+		check(wrong == 0, "batched noise points");
+
+		const VecInt bounds(33, 29);
+		const NoisePointFunc funcs[] = { SimplexPoint, PerlinPoint };
+		const Exec policies[] = { Exec::Serial, Exec::Parallel };
+		for (NoisePointFunc func : funcs)
+		{
+			const Map reference = serialNoise(func, bounds, 4, 77);
+			for (Exec policy : policies)
+			{
+				ExecScope scope(policy);
+				check(identical(Noiser(func, 77)(bounds, 4, false), reference), "Noiser against a serial fill");
+
+				Map added(bounds);
+				Noiser adder(func, 77);
+				for (int oct = 0; oct < 4; oct++) adder.AddOctave(added, oct);
+				check(identical(added, reference), "Noiser::AddOctave against a serial fill");
+			}
+		}
+	}
+
+	// NoiserT inlines the same functions Noiser calls through a pointer
+	void testNoiserT()
+	{
+		const VecInt bounds(33, 29);
+		check(identical(NoiserT<SimplexFunc>(77)(bounds, 4, false), serialNoise(SimplexPoint, bounds, 4, 77)), "NoiserT<SimplexFunc> against a serial fill");
+		check(identical(NoiserT<PerlinFunc>(77)(bounds, 4, false), serialNoise(PerlinPoint, bounds, 4, 77)), "NoiserT<PerlinFunc> against a serial fill");
+	}
+
+	// Whether every element of 'f' is the float nearest that of 'd'
+	bool matchesRounded(const Mapf& f, const Map& d)
+	{
+		if (f.Bounds() != d.Bounds()) return false;
+		for (int x = 0; x < d.Bounds().X; x++)
+		{
+			for (int y = 0; y < d.Bounds().Y; y++)
+			{
+				if (f[x][y] != (float)d[x][y]) return false;
+			}
+		}
+		return true;
+	}
+
+	// Mapf against Map. A single +, -, * or / of two floats, done in double
+	// and rounded to float, gives exactly the float result, so each step is
+	// compared exactly before both maps carry on from the float values.
+	void testMapf()
+	{
+		Mapf f(testMap(VecInt(31, 19), 14));
+		const Mapf g(testMap(VecInt(31, 19), 15));
+		const Map gd = g.ToMap();
+		Map d = f.ToMap();
+
+		auto step = [&](const std::string& what) {
+			check(matchesRounded(f, d), "Mapf " + what + " against Map");
+			d = f.ToMap();
+		};
+
+		f += g;    d += gd;   step("+= map");
+		f -= g;    d -= gd;   step("-= map");
+		f *= g;    d *= gd;   step("*= map");
+		f /= g;    d /= gd;   step("/= map");
+		f += 1.5f; d += 1.5;  step("+= value");
+		f -= 0.25f; d -= 0.25; step("-= value");
+		f *= -3;   d *= -3;   step("*= value");
+		f /= 7;    d /= 7;    step("/= value");
+		f.Abs();   d.Abs();   step("Abs");
+		f.Bound(2, 30); d.Bound(2, 30); step("Bound");
+		f.Interpolate(0, 1); d.Interpolate(0, 1);
+		check(matchesRounded(f, d), "Mapf Interpolate against Map");
+
+		// Stats accumulate in double, so they match Map's over the same values
+		const Mapf stats(testMap(VecInt(57, 33), 16));
+		const MapStats want = stats.ToMap().Stats();
+		const MapStats got = stats.Stats();
+		check(got.min == want.min && got.max == want.max, "Mapf min and max");
+		check(near(got.sum, want.sum, 1e-12) && near(got.mean, want.mean, 1e-12), "Mapf sum and mean");
+		check(near(got.variance, want.variance, 1e-12) && near(got.stdDev, want.stdDev, 1e-12), "Mapf variance");
+		check(stats.GetMin() == (float)want.min && stats.GetMax() == (float)want.max, "Mapf GetMin and GetMax");
+	}
+
+	// SimplexGradient and PerlinGradient against their plain maps: the same
+	// values, and derivatives that match a central difference. The
+	// difference is taken a fraction of a pixel either side by generating
+	// the noise with boxes SUBDIVISIONS times larger, where pixel
+	// SUBDIVISIONS * x lands on the original pixel x. The difference's own
+	// error, a few parts in a million of the largest derivative, sets the
+	// tolerance.
+	void testNoiseGradient()
+	{
+		constexpr int SUBDIVISIONS = 256;
+
+		NoiseConfig cfg;
+		cfg.bounds = VecInt(40, 36);
+		cfg.boxSize = Vec(16, 16);
+		cfg.octaves = 3;
+		cfg.seed = 4242;
+		cfg.normalize = false;
+
+		NoiseConfig fine = cfg;
+		fine.bounds = VecInt(3, 3);
+		fine.boxSize = cfg.boxSize * SUBDIVISIONS;
+
+		for (int type = 0; type < 2; type++)
+		{
+			const std::string name = type ? "PerlinGradient" : "SimplexGradient";
+			auto plain = [&](const NoiseConfig& c, VecInt origin) { return type ? Perlin(c, origin) : Simplex(c, origin); };
+			const NoiseGradient grad = type ? PerlinGradient(cfg) : SimplexGradient(cfg);
+
+			check(identical(grad.value, plain(cfg, VecInt(0, 0))), name + " value");
+
+			double scale = 0, worst = 0;
+			for (int x = 1; x < cfg.bounds.X; x += 3)
+			{
+				for (int y = 2; y < cfg.bounds.Y; y += 5)
+				{
+					// fine[1][1] is pixel (x, y); its neighbours are 1 / SUBDIVISIONS away
+					const Map around = plain(fine, VecInt(x, y) * SUBDIVISIONS - VecInt(1, 1));
+					const double dx = (around[2][1] - around[0][1]) * SUBDIVISIONS / 2;
+					const double dy = (around[1][2] - around[1][0]) * SUBDIVISIONS / 2;
+
+					scale = std::max(scale, std::max(std::abs(dx), std::abs(dy)));
+					worst = std::max(worst, std::max(std::abs(grad.dx[x][y] - dx), std::abs(grad.dy[x][y] - dy)));
+				}
+			}
+			check(scale > 0 && worst <= 1e-5 * scale, name + " derivatives against a central difference");
+		}
+	}
+
+	// Recomposing cached octaves with new weights against generating anew
+	void testOctaveCache()
+	{
+		NoiseConfig cfg;
+		cfg.bounds = VecInt(37, 45);
+		cfg.boxSize = Vec(11.5, 11.5);
+		cfg.seed = 31;
+		const VecInt origin(5, -3);
+
+		for (int type = 0; type < 3; type++)
+		{
+			const NoiseType noiseType = type == 0 ? NoiseType::Simplex : type == 1 ? NoiseType::Perlin : NoiseType::Worley;
+			const std::string name = "OctaveCache " + std::to_string(type);
+			auto generate = [&](const NoiseConfig& c) {
+				return type == 0 ? Simplex(c, origin) : type == 1 ? Perlin(c, origin) : Worley(c, origin);
+			};
+
+			OctaveCache cache(noiseType);
+			NoiseConfig c = cfg;
+			c.octaves = 4;
+			check(identical(cache(c, origin), generate(c)), name + ", first map");
+
+			// Fewer octaves, then more, then without normalization
+			c.octaves = 2;
+			check(identical(cache(c, origin), generate(c)), name + ", fewer octaves");
+			c.octaves = 6;
+			check(identical(cache(c, origin), generate(c)), name + ", more octaves");
+			c.normalize = false;
+			check(identical(cache(c, origin), generate(c)), name + ", unnormalized");
+			check(cache.Layers() == 6, name + " keeps its layers");
+
+			// New weights, which Perlin can't reuse since they also size its boxes
+			c.octDecrease = 0.7;
+			check(identical(cache(c, origin), generate(c)), name + ", new weights");
+			c.octDecrease = 0.35;
+			c.normalize = true;
+			check(identical(cache(c, origin), generate(c)), name + ", new weights again");
+			if (type != 1) check(cache.Layers() == 6, name + " reuses its layers for new weights");
+		}
+	}
+
+	// GenerateBatch against a separate call per seed, in seed order
+	void testGenerateBatch()
+	{
+		NoiseConfig cfg;
+		cfg.bounds = VecInt(23, 19);
+		cfg.boxSize = Vec(7, 7);
+		cfg.octaves = 3;
+
+		// Enough seeds to give every thread some, and a short batch that runs
+		// each map across the threads instead
+		std::vector<int64_t> seeds;
+		for (int i = 0; i < (int)GetThreadCount() * 2 + 3; i++) seeds.push_back(1000 + 7 * i);
+		const std::vector<int64_t> few(seeds.begin(), seeds.begin() + 1);
+
+		const NoiseType types[] = { NoiseType::Simplex, NoiseType::Perlin, NoiseType::Worley };
+		const Exec policies[] = { Exec::Serial, Exec::Parallel };
+		const std::vector<int64_t>* batches[] = { &seeds, &few };
+
+		for (NoiseType type : types)
+		{
+			for (Exec policy : policies)
+			{
+				ExecScope scope(policy);
+				for (const std::vector<int64_t>* batch : batches)
+				{
+					std::vector<Map> got;
+					for (size_t i = 0; i < batch->size(); i++) got.push_back(Map(cfg.bounds));
+					std::vector<int> calls(batch->size(), 0);
+
+					GenerateBatch(type, cfg, *batch, [&](size_t index, int64_t seed, const Map& map) {
+						calls[index]++;
+						if (seed == (*batch)[index]) got[index] = map;
+					});
+
+					bool all = true;
+					for (size_t i = 0; i < batch->size(); i++)
+					{
+						NoiseConfig one = cfg;
+						one.seed = (*batch)[i];
+						const Map want = type == NoiseType::Simplex ? Simplex(one) : type == NoiseType::Perlin ? Perlin(one) : Worley(one);
+						all = all && calls[i] == 1 && identical(got[i], want);
+					}
+					check(all, "GenerateBatch of " + std::to_string(batch->size()) + " seeds, type " + std::to_string((int)type)
+						+ (policy == Exec::Serial ? ", serial" : ", parallel"));
+				}
+			}
+		}
+	}
+
+	// The approximate pow used by Lp-norm Worley noise
+	void testFastPow()
+	{
+		double worst = 0;
+		for (double y = -1020; y < 1020; y += 0.37) worst = std::max(worst, std::abs(fastExp2(y) / std::exp2(y) - 1));
+		check(worst < 1e-6, "fastExp2 accuracy");
+
+		worst = 0;
+		for (double x = 1e-3; x < 1e3; x *= 1.37)
+		{
+			for (double y = -4; y <= 4; y += 0.25) worst = std::max(worst, std::abs(fastPow(x, y) / std::pow(x, y) - 1));
+		}
+		check(worst < 1e-6, "fastPow accuracy");
+
+		check(fastExp2(2000) == std::numeric_limits<double>::infinity() && fastExp2(-2000) == 0, "fastExp2 out of range");
+	}
+
+	// NaN in, NaN out, without reaching an int conversion
+	void testFastPowNaN()
+	{
+		const double nan = std::numeric_limits<double>::quiet_NaN();
+		check(std::isnan(fastExp2(nan)), "fastExp2 of NaN");
+		check(std::isnan(fastPow(nan, 2.5)), "fastPow of NaN");
+		check(std::isnan(fastPow(3, nan)), "fastPow to the power NaN");
+	}
+
+	// A separable Gaussian of the given radius, done directly in double. As
+	// in Image::BlurGaussian, weights that fall past the edges are dropped
+	// and the rest renormalized.
+	std::vector<double> referenceBlur(const Image& img, double sigma, int radius, int channel)
+	{
+		const VecInt bounds = img.Bounds();
+		auto pass = [&](const std::vector<double>& in, bool alongX) {
+			std::vector<double> out(in.size());
+			for (int x = 0; x < bounds.X; x++)
+			{
+				for (int y = 0; y < bounds.Y; y++)
+				{
+					const int at = alongX ? x : y, len = alongX ? bounds.X : bounds.Y;
+					double sum = 0, total = 0;
+					for (int j = std::max(0, at - radius); j <= std::min(len - 1, at + radius); j++)
+					{
+						const double w = std::exp(-0.5 * ((j - at) / sigma) * ((j - at) / sigma));
+						sum += w * in[alongX ? (size_t)j * bounds.Y + y : (size_t)x * bounds.Y + j];
+						total += w;
+					}
+					out[(size_t)x * bounds.Y + y] = sum / total;
+				}
+			}
+			return out;
+		};
+
+		std::vector<double> values((size_t)bounds.X * bounds.Y);
+		for (int x = 0; x < bounds.X; x++) for (int y = 0; y < bounds.Y; y++) values[(size_t)x * bounds.Y + y] = img[x][y][channel];
+		return pass(pass(values, false), true);
+	}
+
+	// The largest and the mean difference between a blurred image and the
+	// reference, over all channels
+	void compareBlur(const Image& img, const Image& blurred, double sigma, int radius, double& worst, double& mean)
+	{
+		worst = mean = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			const std::vector<double> want = referenceBlur(img, sigma, radius, c);
+			for (int x = 0; x < img.Bounds().X; x++)
+			{
+				for (int y = 0; y < img.Bounds().Y; y++)
+				{
+					const double diff = std::abs(blurred[x][y][c] - want[(size_t)x * img.Bounds().Y + y]);
+					worst = std::max(worst, diff);
+					mean += diff;
+				}
+			}
+		}
+		mean /= 4.0 * img.Bounds().Area();
+	}
+
+	// Image::BlurGaussian, in both its direct (sigma up to 5) and recursive forms
+	void testBlurGaussian()
+	{
+		const double sigmas[] = { 2, 12 };
+		for (double sigma : sigmas)
+		{
+			Image flat(VecInt(70, 45));
+			flat.Clear(RGBA(17, 128, 250, 201));
+			flat.BlurGaussian(sigma);
+
+			int wrong = 0;
+			for (int x = 0; x < 70; x++)
+			{
+				for (int y = 0; y < 45; y++)
+				{
+					const RGBA got = flat[x][y];
+					if (got.R != 17 || got.G != 128 || got.B != 250 || got.A != 201) wrong++;
+				}
+			}
+			check(wrong == 0, "Gaussian blur of a constant image, sigma " + std::to_string(sigma));
+		}
+
+		Image noise(VecInt(83, 61));
+		unsigned seed = 17;
+		for (int x = 0; x < 83; x++)
+		{
+			for (int y = 0; y < 61; y++)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				noise[x][y] = RGBA(seed >> 24, (seed >> 16) & 255, (seed >> 8) & 255, (seed >> 4) & 255);
+			}
+		}
+
+		// The direct kernel reaches 2 sigma; it differs from the reference
+		// only by float accumulation and rounding to a channel
+		double worst, mean;
+		Image direct = noise;
+		direct.BlurGaussian(3);
+		compareBlur(noise, direct, 3, 6, worst, mean);
+		check(worst <= 0.5 + 1e-3, "direct Gaussian blur against a reference kernel");
+
+		// Just above the switch, the recursive filter approximates the
+		// Gaussian, 4 sigma either side, to within a level and a half, and
+		// on average to little more than the rounding to a channel
+		Image recursive = noise;
+		recursive.BlurGaussian(5.5);
+		compareBlur(noise, recursive, 5.5, 22, worst, mean);
+		check(worst <= 1.5 && mean <= 0.35, "recursive Gaussian blur against a direct kernel");
+	}
+
+	// SummedArea queries against sums over the same pixels
+	void testSummedArea()
+	{
+		const Map map = testMap(VecInt(23, 31), 3);
+		const SummedArea area(map);
+		const Rect rects[] = {
+			Rect(VecInt(0, 0), VecInt(23, 31)),
+			Rect(VecInt(3, 5), VecInt(11, 7)),
+			Rect(VecInt(-4, -2), VecInt(2, 40)),
+			Rect(VecInt(22, 30), VecInt(23, 31)),
+			SummedArea::Window(VecInt(20, 1), 3),
+		};
+
+		for (const Rect& rect : rects)
+		{
+			const int x0 = std::max(0, (int)rect.min.X), x1 = std::min(23, (int)rect.max.X);
+			const int y0 = std::max(0, (int)rect.min.Y), y1 = std::min(31, (int)rect.max.Y);
+			const double n = (x1 - x0) * (y1 - y0);
+
+			double sum = 0;
+			for (int x = x0; x < x1; x++) for (int y = y0; y < y1; y++) sum += map[x][y];
+			double m2 = 0;
+			for (int x = x0; x < x1; x++) for (int y = y0; y < y1; y++) m2 += (map[x][y] - sum / n) * (map[x][y] - sum / n);
+
+			check(area.Count(rect) == n, "summed area count");
+			check(near(area.Sum(rect), sum, 1e-12), "summed area sum");
+			check(near(area.Mean(rect), sum / n, 1e-12), "summed area mean");
+			check(n < 2 ? area.Variance(rect) == 0 : near(area.Variance(rect), m2 / (n - 1), 1e-10), "summed area variance");
+		}
+		check(area.Sum(Rect(VecInt(30, 0), VecInt(40, 5))) == 0, "summed area outside the map");
+
+		Image img(VecInt(9, 7));
+		for (int x = 0; x < 9; x++) for (int y = 0; y < 7; y++) img[x][y] = RGBA(x * 20, y * 30, (x * y) % 256, 255 - x);
+		const SummedArea channels(img);
+		const Rect rect(VecInt(2, 1), VecInt(6, 5));
+		for (int c = 0; c < 4; c++)
+		{
+			double sum = 0;
+			for (int x = 2; x < 6; x++) for (int y = 1; y < 5; y++) sum += img[x][y][c];
+			check(near(channels.Sum(rect, c), sum, 1e-12), "summed area image channel sum");
+		}
+	}
+
+	// Adding a constant must not change the local contrast, however large
+	void testSummedAreaOffset()
+	{
+		Map small = testMap(VecInt(512, 512), 4);
+		small *= 1e-4;
+		Map shifted = small;
+		shifted += 1e4;
+		small.LocalContrast(2);
+		shifted.LocalContrast(2);
+
+		double worst = 0;
+		for (int x = 0; x < 512; x++) for (int y = 0; y < 512; y++) worst = std::max(worst, std::abs(small[x][y] - shifted[x][y]));
+		check(worst < 1e-6, "local contrast under a constant offset");
+	}
+
+	// Map::Resize and Image::Resize against values worked out by hand
+	void testResize()
+	{
+		const Filter filters[] = { Filter::Nearest, Filter::Area, Filter::Bilinear, Filter::Bicubic, Filter::Lanczos3 };
+		const VecInt sizes[] = { VecInt(7, 5), VecInt(20, 13), VecInt(3, 40) };
+
+		for (Filter filter : filters)
+		{
+			const std::string name = "resize filter " + std::to_string((int)filter);
+
+			// Weights sum to 1, so a constant stays constant
+			for (VecInt size : sizes)
+			{
+				Map flat(VecInt(11, 9));
+				flat.Clear(3.25);
+				flat.Resize(size, filter);
+
+				double worst = 0;
+				for (int x = 0; x < size.X; x++) for (int y = 0; y < size.Y; y++) worst = std::max(worst, std::abs(flat[x][y] - 3.25));
+				check(flat.Bounds() == size && worst < 1e-12, name + ": constant");
+			}
+
+			// Every filter's kernel is 1 at 0 and 0 at other integers
+			const Map source = testMap(VecInt(9, 6), 6);
+			Map same = source;
+			same.Resize(source.Bounds(), filter);
+			double worst = 0;
+			for (int x = 0; x < 9; x++) for (int y = 0; y < 6; y++) worst = std::max(worst, std::abs(same[x][y] - source[x][y]));
+			check(worst < 1e-12, name + ": same size");
+		}
+
+		// Area: halving averages 2x2 blocks, and a third of a pixel is weighed as such
+		const Map source = testMap(VecInt(8, 6), 7);
+		Map half = source;
+		half.Resize(VecInt(4, 3), Filter::Area);
+		double worst = 0;
+		for (int x = 0; x < 4; x++)
+		{
+			for (int y = 0; y < 3; y++)
+			{
+				const double mean = (source[2 * x][2 * y] + source[2 * x + 1][2 * y] + source[2 * x][2 * y + 1] + source[2 * x + 1][2 * y + 1]) / 4;
+				worst = std::max(worst, std::abs(half[x][y] - mean));
+			}
+		}
+		check(worst < 1e-12, "area halving");
+
+		Map row(VecInt(3, 1));
+		row.Set(0, 0, 3); row.Set(1, 0, 6); row.Set(2, 0, 9);
+		row.Resize(VecInt(2, 1), Filter::Area);
+		check(near(row[0][0], (3 + 6 * 0.5) / 1.5, 1e-12) && near(row[1][0], (6 * 0.5 + 9) / 1.5, 1e-12), "area by thirds");
+
+		// Bilinear doubling of 0, 1: centres at -0.25, 0.25, 0.75, 1.25, clamped at the edges
+		Map pair(VecInt(2, 1));
+		pair.Set(1, 0, 1);
+		pair.Resize(VecInt(4, 1), Filter::Bilinear);
+		check(near(pair[0][0], 0, 1e-12) && near(pair[1][0], 0.25, 1e-12) && near(pair[2][0], 0.75, 1e-12) && near(pair[3][0], 1, 1e-12), "bilinear doubling");
+
+		// Keys cubic reproduces a ramp away from the edges; 4x upscaling puts
+		// output i at source position (i + 0.5) / 4 - 0.5
+		Map ramp(VecInt(1, 12));
+		for (int y = 0; y < 12; y++) ramp.Set(0, y, 2 * y + 1);
+		ramp.Resize(VecInt(1, 48), Filter::Bicubic);
+		worst = 0;
+		for (int i = 8; i < 40; i++) worst = std::max(worst, std::abs(ramp[0][i] - (2 * ((i + 0.5) / 4 - 0.5) + 1)));
+		check(worst < 1e-12, "bicubic ramp");
+
+		// Nearest matches the original Image::Resize: output (x, y) takes
+		// source (int)(x * scale), per axis
+		Image img(VecInt(13, 7));
+		for (int x = 0; x < 13; x++) for (int y = 0; y < 7; y++) img[x][y] = RGBA(x * 19, y * 37, x * y, 200);
+		for (VecInt size : sizes)
+		{
+			Image resized = img;
+			resized.Resize(size);
+			const Vec scale = Vec(img.Bounds()) / Vec(size);
+
+			int wrong = 0;
+			for (int x = 0; x < size.X; x++)
+			{
+				for (int y = 0; y < size.Y; y++)
+				{
+					const RGBA want = img[(int)(x * scale.X)][(int)(y * scale.Y)];
+					const RGBA got = resized[x][y];
+					if (got.R != want.R || got.G != want.G || got.B != want.B || got.A != want.A) wrong++;
+				}
+			}
+			check(wrong == 0, "nearest image resize");
+		}
+
+		// Filtered image resizing rounds each channel back to 0..255
+		Image flat(VecInt(10, 10));
+		flat.Clear(RGBA(10, 100, 250, 255));
+		flat.Resize(VecInt(17, 4), Filter::Lanczos3);
+		int wrong = 0;
+		for (int x = 0; x < 17; x++)
+		{
+			for (int y = 0; y < 4; y++)
+			{
+				const RGBA got = flat[x][y];
+				if (got.R != 10 || got.G != 100 || got.B != 250 || got.A != 255) wrong++;
+			}
+		}
+		check(wrong == 0, "filtered image resize of a constant");
+	}
+
+	// Image loading and saving, against stb's own row-major buffers. The
+	// bounds are not multiples of the transpose tile.
+	void testLoadSave()
+	{
+		const VecInt bounds(45, 70);
+		const std::string path = "unit_tests_image.png";
+
+		// An image written by stb directly loads with pixel (x, y) in place
+		std::vector<unsigned char> rows((size_t)bounds.X * bounds.Y * 4);
+		unsigned seed = 8;
+		for (unsigned char& byte : rows)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			byte = (unsigned char)(seed >> 24);
+		}
+		stbi_write_png(path.c_str(), bounds.X, bounds.Y, 4, rows.data(), bounds.X * 4);
+
+		const Image loaded(path);
+		int wrong = loaded.Bounds() == bounds ? 0 : 1;
+		for (int x = 0; x < bounds.X && !wrong; x++)
+		{
+			for (int y = 0; y < bounds.Y; y++)
+			{
+				const unsigned char* want = &rows[((size_t)y * bounds.X + x) * 4];
+				const RGBA got = loaded[x][y];
+				if (got.R != want[0] || got.G != want[1] || got.B != want[2] || got.A != want[3]) wrong++;
+			}
+		}
+		check(wrong == 0, "image load");
+
+		// And what Image saves reads back in stb's layout, with or without alpha
+		for (int channels : { 4, 3 })
+		{
+			loaded.Save(path, channels);
+			int w = 0, h = 0, n = 0;
+			unsigned char* saved = stbi_load(path.c_str(), &w, &h, &n, 4);
+
+			wrong = saved && w == bounds.X && h == bounds.Y && n == channels ? 0 : 1;
+			for (size_t i = 0; i < rows.size() && !wrong; i++)
+			{
+				const int want = channels == 3 && i % 4 == 3 ? 255 : rows[i];
+				if (saved[i] != want) wrong++;
+			}
+			check(wrong == 0, "image save with " + std::to_string(channels) + " channels");
+			stbi_image_free(saved);
+		}
+
+		std::remove(path.c_str());
+	}
+
+	// The lowest-indexed palette entry nearest 'col', by brute force
+	int linearNearest(const std::vector<RGBA>& palette, RGBA col)
+	{
+		int best = 0, bestDist = -1;
+		for (size_t i = 0; i < palette.size(); i++)
+		{
+			const int dR = col.R - palette[i].R, dG = col.G - palette[i].G, dB = col.B - palette[i].B;
+			const int dist = dR * dR + dG * dG + dB * dB;
+			if (bestDist < 0 || dist < bestDist)
+			{
+				best = (int)i;
+				bestDist = dist;
+			}
+		}
+		return best;
+	}
+
+	// PaletteIndex, with and without its cube, against a linear scan
+	void testPaletteIndex()
+	{
+		unsigned seed = 5;
+		auto next = [&]() {
+			seed = seed * 1664525u + 1013904223u;
+			return (int)(seed >> 24);
+		};
+
+		std::vector<RGBA> palette;
+		for (int i = 0; i < 150; i++) palette.push_back(RGBA(next(), next(), next(), next()));
+		// Duplicates, which must resolve to the first copy
+		palette.push_back(palette[7]);
+		palette.push_back(palette[42]);
+		palette.insert(palette.begin() + 3, palette[100]);
+		// Exact ties between distinct entries, either side of 128 on each axis
+		palette.push_back(RGBA(120, 0, 0));
+		palette.push_back(RGBA(136, 0, 0));
+		palette.push_back(RGBA(0, 120, 255));
+		palette.push_back(RGBA(0, 136, 255));
+		palette.push_back(RGBA(255, 255, 120));
+		palette.push_back(RGBA(255, 255, 136));
+
+		std::vector<RGBA> queries = { RGBA(128, 0, 0), RGBA(0, 128, 255), RGBA(255, 255, 128) };
+		for (int r = 0; r < 256; r += 15)
+			for (int g = 0; g < 256; g += 15)
+				for (int b = 0; b < 256; b += 15)
+					queries.push_back(RGBA(r, g, b));
+		for (const RGBA& col : palette) queries.push_back(col);
+		for (int i = 0; i < 2000; i++) queries.push_back(RGBA(next(), next(), next()));
+
+		for (int bits : { 0, 5, 6 })
+		{
+			const PaletteIndex index(palette, bits);
+			int wrong = 0;
+			for (const RGBA& col : queries)
+			{
+				if (index.Nearest(col) != linearNearest(palette, col)) wrong++;
+			}
+			check(wrong == 0, "palette index with " + std::to_string(bits) + " cube bits");
+		}
+
+		// A single entry, and a palette of nothing but one color
+		check(PaletteIndex({ RGBA(1, 2, 3) }, 6).Nearest(RGBA(200, 200, 200)) == 0, "single-entry palette");
+		check(PaletteIndex(std::vector<RGBA>(20, RGBA(9, 9, 9)), 5).Nearest(RGBA(0, 0, 0)) == 0, "all-duplicate palette");
+
+		// RestrictPalette picks the cube or the tree by size; both must agree
+		// with the scan. 4096 pixels over 16 colors takes the cube.
+		const std::vector<RGBA> small(palette.begin(), palette.begin() + 16);
+		const std::vector<RGBA>* palettes[] = { &small, &palette };
+		for (const std::vector<RGBA>* pal : palettes)
+		{
+			Image img(VecInt(64, 64));
+			for (int x = 0; x < 64; x++) for (int y = 0; y < 64; y++) img[x][y] = RGBA(next(), next(), next());
+			Image restricted = img;
+			restricted.RestrictPalette(*pal);
+
+			int wrong = 0;
+			for (int x = 0; x < 64; x++)
+			{
+				for (int y = 0; y < 64; y++)
+				{
+					const RGBA want = (*pal)[linearNearest(*pal, img[x][y])];
+					const RGBA got = restricted[x][y];
+					if (got.R != want.R || got.G != want.G || got.B != want.B || got.A != want.A) wrong++;
+				}
+			}
+			check(wrong == 0, "RestrictPalette with " + std::to_string(pal->size()) + " colors");
+		}
+	}
+}
+
 int main()
 {
-	Map map(1000, 1000);
+	testSimd();
+	testSimdReductions();
+	testLazy();
+	testStats();
+	testStatsHeldPointer();
+	testStatsHeldReference();
+	testNoiseExec();
+	testNoiser();
+	testNoiserT();
+	testMapf();
+	testNoiseGradient();
+	testOctaveCache();
+	testGenerateBatch();
+	testFastPow();
+	testFastPowNaN();
+	testBlurGaussian();
+	testSummedArea();
+	testSummedAreaOffset();
+	testResize();
+	testLoadSave();
+	testPaletteIndex();
 
-	return 0;
+	if (failures) std::cerr << failures << " check(s) failed\n";
+	return failures ? 1 : 0;
 }